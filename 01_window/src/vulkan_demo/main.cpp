@@ -167,7 +167,7 @@ private:
 
     void mainLoop() {
         while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            glfwWaitEvents();
         }
     }
 
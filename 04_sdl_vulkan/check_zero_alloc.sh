@@ -0,0 +1,18 @@
+#!/bin/sh
+# Runs the headless backend with --assert-zero-alloc in the configurations whose frame loop must not allocate, and fails
+# if any of them does. Usage: ./check_zero_alloc.sh [path/to/main], e.g. on machines without a GPU:
+#   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./check_zero_alloc.sh build/main
+set -e
+
+main=${1:-./main}
+
+run() {
+    echo "$main --headless --benchmark-frames 1000 --assert-zero-alloc $*"
+    "$main" --headless --benchmark-frames 1000 --assert-zero-alloc "$@"
+}
+
+run
+run --record-every-frame
+run --record-every-frame --record-threads 4
+run --instances 100000 --draw-mode direct --record-every-frame --rotation-speed 1
+run --instances 100000 --scene-scale 4 --draw-mode indirect
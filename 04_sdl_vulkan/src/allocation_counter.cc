@@ -0,0 +1,74 @@
+#include "allocation_counter.hh"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Per thread, so the log drain, pipeline compilation and latency monitor threads don't count
+thread_local bool counting = false;
+thread_local uint64_t allocation_count = 0;
+}
+
+void start_counting_allocations() {
+    allocation_count = 0;
+    counting = true;
+}
+
+uint64_t stop_counting_allocations() {
+    counting = false;
+    return allocation_count;
+}
+
+// Aligned allocations aren't counted, none happen per frame
+void* operator new(std::size_t size) {
+    if (counting)
+        ++allocation_count;
+    for (;;) {
+        if (const auto pointer = std::malloc(size ? size : 1))
+            return pointer;
+        const auto handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
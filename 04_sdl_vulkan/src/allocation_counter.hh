@@ -0,0 +1,11 @@
+#ifndef ALLOCATION_COUNTER_HH_
+#define ALLOCATION_COUNTER_HH_
+
+#include <cstdint>
+
+// Counts the allocations made by the calling thread through the global operator new between these calls, call both on
+// the thread that runs draw_frame(). Outside of them, the replaced operator new only costs a thread local load.
+void start_counting_allocations();
+uint64_t stop_counting_allocations();
+
+#endif
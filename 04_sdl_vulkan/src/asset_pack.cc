@@ -0,0 +1,216 @@
+#include "asset_pack.hh"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char MAGIC[4] = {'H', 'V', 'A', 'P'};
+const uint32_t FILE_VERSION = 1;
+// A cache line, so copies out of the mapping start aligned and SPIR-V can be used in place
+const uint64_t BLOB_ALIGNMENT = 64;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t toc_crc;
+    uint64_t toc_offset;
+    uint64_t file_size;
+};
+
+static_assert(sizeof(Header) == 32 && sizeof(AssetPackEntry) == 80, "Asset pack structures must not have padding");
+
+// Table i advances the CRC of a byte followed by i zero bytes
+constexpr auto CRC_TABLES = [] {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 1 ? crc >> 1 ^ 0xedb88320 : crc >> 1;
+        tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (size_t table = 1; table < tables.size(); table++)
+            tables[table][i] = tables[table - 1][i] >> 8 ^ tables[0][tables[table - 1][i] & 0xff];
+    }
+    return tables;
+}();
+
+uint64_t align(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+}
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    const auto& tables = CRC_TABLES;
+    auto bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    // Slicing by 8: eight independent lookups per 8 bytes instead of a chain of dependent ones
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint32_t low, high;
+        std::memcpy(&low, bytes, sizeof(low));
+        std::memcpy(&high, bytes + 4, sizeof(high));
+        low ^= crc;
+        crc = tables[7][low & 0xff] ^ tables[6][low >> 8 & 0xff] ^ tables[5][low >> 16 & 0xff] ^ tables[4][low >> 24]
+                ^ tables[3][high & 0xff] ^ tables[2][high >> 8 & 0xff] ^ tables[1][high >> 16 & 0xff] ^ tables[0][high >> 24];
+    }
+    for (; size; size--, bytes++)
+        crc = crc >> 8 ^ tables[0][(crc ^ *bytes) & 0xff];
+    return ~crc;
+}
+
+AssetPack::AssetPack(const std::string& path) : path_(path) {
+#ifdef _WIN32
+    const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open asset pack " + path);
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || static_cast<uint64_t>(file_size.QuadPart) < sizeof(Header)) {
+        CloseHandle(file);
+        throw std::runtime_error("Invalid asset pack " + path);
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping_handle_)
+        throw std::runtime_error("Failed to map asset pack " + path);
+    data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        CloseHandle(mapping_handle_);
+        throw std::runtime_error("Failed to map asset pack " + path);
+    }
+#else
+    const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        throw std::runtime_error("Failed to open asset pack " + path + ": " + std::strerror(errno));
+    struct stat status;
+    if (fstat(file, &status) || static_cast<uint64_t>(status.st_size) < sizeof(Header)) {
+        close(file);
+        throw std::runtime_error("Invalid asset pack " + path);
+    }
+    size_ = static_cast<size_t>(status.st_size);
+    // The mapping keeps the file open
+    const auto mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Failed to map asset pack " + path + ": " + std::strerror(errno));
+    data_ = static_cast<const std::byte*>(mapping);
+#endif
+
+    Header header;
+    std::memcpy(&header, data_, sizeof(header));
+    const auto toc_size = uint64_t(header.entry_count) * sizeof(AssetPackEntry);
+    std::string error;
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.version != FILE_VERSION)
+        error = "Not an asset pack of version " + std::to_string(FILE_VERSION);
+    else if (header.file_size != size_ || header.toc_offset % BLOB_ALIGNMENT || header.toc_offset > size_ || toc_size > size_ - header.toc_offset)
+        error = "Truncated asset pack";
+    else if (crc32(data_ + header.toc_offset, toc_size) != header.toc_crc)
+        error = "Corrupted asset pack table of contents";
+    if (error.empty()) {
+        entries_ = reinterpret_cast<const AssetPackEntry*>(data_ + header.toc_offset);
+        entry_count_ = header.entry_count;
+        for (const auto& entry : std::span(entries_, entry_count_)) {
+            if (!std::memchr(entry.name, 0, sizeof(entry.name)) || entry.offset < sizeof(Header) || entry.offset % BLOB_ALIGNMENT || entry.offset > header.toc_offset
+                    || entry.size > header.toc_offset - entry.offset)
+                error = "Invalid asset pack entry";
+        }
+    }
+    if (!error.empty()) {
+        unmap();
+        throw std::runtime_error(error + ": " + path);
+    }
+}
+
+AssetPack::~AssetPack() {
+    unmap();
+}
+
+void AssetPack::unmap() {
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_handle_);
+#else
+    munmap(const_cast<std::byte*>(data_), size_);
+#endif
+}
+
+Asset AssetPack::get(std::string_view name, AssetType type) const {
+    const auto entries = std::span(entries_, entry_count_);
+    const auto entry = std::find_if(entries.begin(), entries.end(), [name](const AssetPackEntry& entry) { return name == entry.name; });
+    if (entry == entries.end() || entry->type != type)
+        throw std::runtime_error("No asset " + std::string(name) + " of the expected type in " + path_);
+    const auto data = data_ + entry->offset;
+#ifndef _WIN32
+    // Whole pages around the asset, the checksum below then reads them at disk speed
+    const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const auto page_start = reinterpret_cast<uintptr_t>(data) / page_size * page_size;
+    posix_madvise(reinterpret_cast<void*>(page_start), reinterpret_cast<uintptr_t>(data) + entry->size - page_start, POSIX_MADV_WILLNEED);
+#endif
+    if (crc32(data, entry->size) != entry->crc)
+        throw std::runtime_error("Corrupted asset " + std::string(name) + " in " + path_);
+    return {entry->type, entry->format, entry->count, data, entry->size};
+}
+
+AssetPackWriter::AssetPackWriter() : contents_(sizeof(Header)) {
+}
+
+void AssetPackWriter::add(std::string_view name, AssetType type, uint32_t format, uint32_t count, const void* data, size_t size) {
+    if (name.empty() || name.size() >= ASSET_NAME_SIZE)
+        throw std::runtime_error("Asset names must have 1 to " + std::to_string(ASSET_NAME_SIZE - 1) + " characters: " + std::string(name));
+    if (std::any_of(entries_.begin(), entries_.end(), [name](const AssetPackEntry& entry) { return name == entry.name; }))
+        throw std::runtime_error("Duplicate asset " + std::string(name));
+    contents_.resize(align(contents_.size(), BLOB_ALIGNMENT));
+    AssetPackEntry entry{};
+    std::memcpy(entry.name, name.data(), name.size());
+    entry.type = type;
+    entry.format = format;
+    entry.offset = contents_.size();
+    entry.size = size;
+    entry.count = count;
+    entry.crc = crc32(data, size);
+    const auto bytes = static_cast<const std::byte*>(data);
+    contents_.insert(contents_.end(), bytes, bytes + size);
+    entries_.push_back(entry);
+}
+
+void AssetPackWriter::write(const std::string& path) const {
+    const auto toc_size = entries_.size() * sizeof(AssetPackEntry);
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FILE_VERSION;
+    header.entry_count = entries_.size();
+    header.toc_crc = crc32(entries_.data(), toc_size);
+    header.toc_offset = align(contents_.size(), BLOB_ALIGNMENT);
+    header.file_size = header.toc_offset + toc_size;
+
+    const auto temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        const std::vector<char> padding(header.toc_offset - contents_.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(contents_.data()) + sizeof(header), contents_.size() - sizeof(header));
+        file.write(padding.data(), padding.size());
+        file.write(reinterpret_cast<const char*>(entries_.data()), toc_size);
+        if (!file)
+            throw std::runtime_error("Failed to write asset pack " + temporary_path);
+    }
+    std::filesystem::rename(temporary_path, path);
+}
@@ -0,0 +1,99 @@
+#ifndef ASSET_PACK_HH_
+#define ASSET_PACK_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Assets of the demo scene, written by asset_packer
+const auto MESH_VERTICES_ASSET = "mesh.vertices";
+const auto MESH_INDICES_ASSET = "mesh.indices";
+const auto MESH_BOUNDS_ASSET = "mesh.bounds";
+const auto VERTEX_SHADER_ASSET = "shader.vert";
+const auto FRAGMENT_SHADER_ASSET = "shader.frag";
+
+enum class AssetType : uint32_t {
+    // Format is a VertexFormat, count the number of vertices
+    vertices,
+    // Format is the size of an index in bytes, count the number of indices
+    indices,
+    // Count is the number of 32-bit words
+    spirv,
+    // Bounding sphere as 4 floats, center then radius
+    bounds,
+    raw,
+};
+
+const size_t ASSET_NAME_SIZE = 48;
+
+// Table of contents entry of an asset pack
+struct AssetPackEntry {
+    // Null terminated
+    char name[ASSET_NAME_SIZE];
+    AssetType type;
+    uint32_t format;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t count;
+    uint32_t crc;
+};
+
+// The zlib CRC-32, continuing from crc
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+struct Asset {
+    AssetType type;
+    uint32_t format;
+    uint32_t count;
+    // Points into the mapping, valid as long as the pack
+    const std::byte* data;
+    uint64_t size;
+};
+
+// Read-only memory mapping of an asset pack file: a header, the assets each aligned to 64 bytes, then the table of contents.
+// Every asset and the table have a checksum, so corruption is caught before anything is used. Little endian only.
+// Assets are used in place: uploads copy straight from the mapping into the staging memory and SPIR-V is handed to the
+// driver without being read into the heap first.
+class AssetPack {
+public:
+    // Throws std::runtime_error if the file can't be mapped or its header or table of contents are invalid
+    explicit AssetPack(const std::string& path);
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+    ~AssetPack();
+
+    // Throws std::runtime_error if there is no such asset of this type or its checksum doesn't match. Asks the system to
+    // read the asset ahead, so the page faults of the first copy don't wait on the disk one page at a time.
+    [[nodiscard]] Asset get(std::string_view name, AssetType type) const;
+    [[nodiscard]] const std::string& get_path() const { return path_; }
+
+private:
+    const std::string path_;
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+    // Windows file mapping object, unused elsewhere
+    void* mapping_handle_ = nullptr;
+    const AssetPackEntry* entries_ = nullptr;
+    uint32_t entry_count_ = 0;
+
+    void unmap();
+};
+
+// Builds an asset pack in memory, for the packer tool
+class AssetPackWriter {
+public:
+    AssetPackWriter();
+    // Throws std::runtime_error if the name is too long or already used
+    void add(std::string_view name, AssetType type, uint32_t format, uint32_t count, const void* data, size_t size);
+    // Throws std::runtime_error on failure. Written to a temporary file first, so an existing pack is never left truncated.
+    void write(const std::string& path) const;
+
+private:
+    std::vector<AssetPackEntry> entries_;
+    // Assets at their offset in the file, after room for the header
+    std::vector<std::byte> contents_;
+};
+
+#endif
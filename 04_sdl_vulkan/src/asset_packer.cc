@@ -0,0 +1,105 @@
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "asset_pack.hh"
+#include "mesh.hh"
+#include "mesh_optimizer.hh"
+
+#include "shader.frag.h"
+#include "shader.vert.h"
+
+// Offline tool writing the demo scene into an asset pack, which main loads with --asset-pack
+
+namespace {
+void print_packer_usage(std::ostream& stream) {
+    stream << "Usage: asset_packer OUTPUT [options]\n"
+              "  --mesh-subdivisions N  split the triangle into N² triangles, at most 360 (default 1)\n"
+              "  --vertex-format FORMAT float (default), half or snorm16, see main's option\n"
+              "  --optimize             reorder the mesh for the vertex cache, overdraw and fetches, so main doesn't have to\n"
+              "  --add NAME FILE        also pack FILE as a raw asset\n";
+}
+
+std::vector<char> read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open " + path);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        print_packer_usage(std::cerr);
+        return 1;
+    }
+    const std::string output = argv[1];
+    uint32_t subdivisions = 1;
+    auto vertex_format = VertexFormat::float32;
+    bool optimize = false;
+    std::vector<std::pair<std::string, std::string>> raw_files;
+    for (int i = 2; i < argc; i++) {
+        const std::string_view option = argv[i];
+        if (option == "--optimize") {
+            optimize = true;
+            continue;
+        }
+        const auto values = option == "--add" ? 2 : 1;
+        if (i + values >= argc) {
+            print_packer_usage(std::cerr);
+            return 1;
+        }
+        const std::string_view value = argv[i + 1];
+        if (option == "--mesh-subdivisions") {
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), subdivisions);
+            if (error != std::errc() || end != value.data() + value.size() || !subdivisions || subdivisions > MAX_MESH_SUBDIVISIONS) {
+                std::cerr << "--mesh-subdivisions: expected an integer in [1, " << MAX_MESH_SUBDIVISIONS << "]\n";
+                return 1;
+            }
+        } else if (option == "--vertex-format" && (value == "float" || value == "half" || value == "snorm16")) {
+            vertex_format = value == "float" ? VertexFormat::float32 : value == "half" ? VertexFormat::half : VertexFormat::snorm16;
+        } else if (option == "--add") {
+            raw_files.emplace_back(value, argv[i + 2]);
+        } else {
+            print_packer_usage(std::cerr);
+            return 1;
+        }
+        i += values;
+    }
+
+    try {
+        AssetPackWriter writer;
+        auto mesh = generate_mesh(subdivisions);
+        const auto statistics = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        std::cout << "Mesh ACMR " << statistics.acmr << ", ATVR " << statistics.atvr << " with a " << VERTEX_CACHE_SIZE << " entry vertex cache\n";
+        if (optimize) {
+            optimize_mesh(mesh);
+            const auto optimized = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+            std::cout << "Optimized ACMR " << optimized.acmr << ", ATVR " << optimized.atvr << "\n";
+        }
+        const auto vertices = encode_vertices(mesh.vertices, vertex_format);
+        writer.add(MESH_VERTICES_ASSET, AssetType::vertices, static_cast<uint32_t>(vertex_format), mesh.vertices.size(), vertices.data(), vertices.size());
+        writer.add(MESH_INDICES_ASSET, AssetType::indices, sizeof(uint16_t), mesh.indices.size(), mesh.indices.data(), mesh.indices.size() * sizeof(uint16_t));
+        const glm::vec4 bounds(0.f, 0.f, 0.f, compute_radius(mesh.vertices));
+        writer.add(MESH_BOUNDS_ASSET, AssetType::bounds, 0, 1, &bounds, sizeof(bounds));
+        writer.add(VERTEX_SHADER_ASSET, AssetType::spirv, 0, std::size(shader_vert_spirv), shader_vert_spirv, sizeof(shader_vert_spirv));
+        writer.add(FRAGMENT_SHADER_ASSET, AssetType::spirv, 0, std::size(shader_frag_spirv), shader_frag_spirv, sizeof(shader_frag_spirv));
+        for (const auto& [name, path] : raw_files) {
+            const auto data = read_file(path);
+            writer.add(name, AssetType::raw, 0, data.size(), data.data(), data.size());
+        }
+        writer.write(output);
+        std::cout << "Wrote " << output << " with a mesh of " << mesh.vertices.size() << " vertices and " << mesh.indices.size() / 3 << " triangles, "
+                  << get_vertex_layout(vertex_format).binding.stride << " bytes per vertex\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Runtime error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
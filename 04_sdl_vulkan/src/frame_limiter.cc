@@ -0,0 +1,19 @@
+#include "frame_limiter.hh"
+
+#include <thread>
+
+FrameLimiter::FrameLimiter(double frames_per_second, Clock::duration spin_duration) :
+    period_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / frames_per_second))), spin_duration_(spin_duration),
+    next_frame_(Clock::now() + period_) {}
+
+void FrameLimiter::wait() {
+    const auto now = Clock::now();
+    if (now >= next_frame_ + period_) {
+        next_frame_ = now + period_;
+        return;
+    }
+    if (next_frame_ - now > spin_duration_)
+        std::this_thread::sleep_until(next_frame_ - spin_duration_);
+    while (Clock::now() < next_frame_) {}
+    next_frame_ += period_;
+}
@@ -0,0 +1,24 @@
+#ifndef FRAME_LIMITER_HH_
+#define FRAME_LIMITER_HH_
+
+#include <chrono>
+
+// Paces a loop to a target rate. Sleeping alone overshoots by the OS timer granularity, so the limiter sleeps until
+// shortly before the deadline and spins for the rest.
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // spin_duration should exceed the sleep overshoot of the OS
+    explicit FrameLimiter(double frames_per_second, Clock::duration spin_duration = std::chrono::milliseconds(2));
+    // Returns at the start of the next frame period. If the caller fell behind by more than a period, the schedule
+    // restarts from now instead of rendering a burst of frames to catch up.
+    void wait();
+
+private:
+    const Clock::duration period_;
+    const Clock::duration spin_duration_;
+    Clock::time_point next_frame_;
+};
+
+#endif
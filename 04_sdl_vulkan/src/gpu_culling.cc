@@ -0,0 +1,99 @@
+#include "gpu_culling.hh"
+
+#include <algorithm>
+
+#include "cull.comp.h"
+
+namespace {
+// local_size_x of cull.comp
+const uint32_t WORKGROUP_SIZE = 64;
+// Smallest maxComputeWorkGroupCount the specification allows in each dimension, e.g. lavapipe's and Intel's
+const uint32_t MAX_WORKGROUP_COUNT = 65535;
+}
+
+GpuCulling::GpuCulling(MemoryAllocator& memory_allocator, vk::PipelineCache pipeline_cache, vk::Buffer bounds_buffer, uint32_t object_count, uint32_t index_count,
+        PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count) :
+    memory_allocator_(memory_allocator), device_(memory_allocator.get_device()), allocation_callbacks_(memory_allocator.get_allocation_callbacks()), bounds_buffer_(bounds_buffer), object_count_(object_count), index_count_(index_count),
+    draw_indirect_count_(draw_indirect_count) {
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++)
+        bindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    descriptor_set_layout_ = device_.createDescriptorSetLayoutUnique(vk::DescriptorSetLayoutCreateInfo({}, bindings.size(), bindings.data()), allocation_callbacks_);
+
+    const vk::PushConstantRange push_constant_range(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants));
+    pipeline_layout_ = device_.createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &*descriptor_set_layout_, 1, &push_constant_range), allocation_callbacks_);
+
+    const auto shader = device_.createShaderModuleUnique(vk::ShaderModuleCreateInfo({}, sizeof(cull_comp_spirv), cull_comp_spirv), allocation_callbacks_);
+    // Compacting is fixed for the device, so its branch is resolved when compiling rather than taken at runtime
+    const auto specialization = SpecializationConstants::from(CullConstants{draw_indirect_count_ != nullptr});
+    const auto specialization_info = specialization.info();
+    const vk::ComputePipelineCreateInfo create_info({}, vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, *shader, "main", &specialization_info), *pipeline_layout_);
+    auto pipeline_result_value = device_.createComputePipelinesUnique(pipeline_cache, create_info, allocation_callbacks_);
+    if (pipeline_result_value.result != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to create culling pipeline");
+    pipeline_ = std::move(pipeline_result_value.value[0]);
+}
+
+void GpuCulling::resize(uint32_t image_count) {
+    if (images_.size() == image_count)
+        return;
+    images_.clear();
+    const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, 3 * image_count);
+    descriptor_pool_ = device_.createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, image_count, 1, &pool_size), allocation_callbacks_);
+
+    images_.resize(image_count);
+    for (auto& image : images_) {
+        image.commands = memory_allocator_.create_buffer(object_count_ * sizeof(vk::DrawIndexedIndirectCommand),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        image.count = memory_allocator_.create_buffer(sizeof(uint32_t),
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        // Freed with the pool
+        image.descriptor_set = device_.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(*descriptor_pool_, 1, &*descriptor_set_layout_))[0];
+
+        const std::array<vk::DescriptorBufferInfo, 3> buffer_infos = {
+            vk::DescriptorBufferInfo(bounds_buffer_, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(*image.commands.buffer, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(*image.count.buffer, 0, VK_WHOLE_SIZE),
+        };
+        std::array<vk::WriteDescriptorSet, 3> writes;
+        for (uint32_t i = 0; i < writes.size(); i++)
+            writes[i] = vk::WriteDescriptorSet(image.descriptor_set, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &buffer_infos[i]);
+        device_.updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+    }
+}
+
+void GpuCulling::record_culling(vk::CommandBuffer command_buffer, uint32_t image_index, const std::array<glm::vec4, 4>& frustum_planes) const {
+    const auto& image = images_[image_index];
+    if (draw_indirect_count_) {
+        command_buffer.fillBuffer(*image.count.buffer, 0, sizeof(uint32_t), 0);
+        const vk::BufferMemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, *image.count.buffer, 0, VK_WHOLE_SIZE);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline_);
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipeline_layout_, 0, 1, &image.descriptor_set, 0, nullptr);
+    const PushConstants push_constants{frustum_planes, object_count_, index_count_};
+    command_buffer.pushConstants(*pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(push_constants), &push_constants);
+    // Rows of at most MAX_WORKGROUP_COUNT workgroups, so millions of objects stay within the guaranteed limits
+    const auto workgroup_count = (object_count_ + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+    const auto row_length = std::min(workgroup_count, MAX_WORKGROUP_COUNT);
+    command_buffer.dispatch(row_length, (workgroup_count + row_length - 1) / row_length, 1);
+
+    const std::array<vk::BufferMemoryBarrier, 2> barriers = {
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                *image.commands.buffer, 0, VK_WHOLE_SIZE),
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                *image.count.buffer, 0, VK_WHOLE_SIZE),
+    };
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect, {}, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+}
+
+void GpuCulling::record_draw(vk::CommandBuffer command_buffer, uint32_t image_index) const {
+    const auto& image = images_[image_index];
+    if (draw_indirect_count_)
+        draw_indirect_count_(static_cast<VkCommandBuffer>(command_buffer), static_cast<VkBuffer>(*image.commands.buffer), 0, static_cast<VkBuffer>(*image.count.buffer), 0,
+                object_count_, sizeof(vk::DrawIndexedIndirectCommand));
+    else
+        command_buffer.drawIndexedIndirect(*image.commands.buffer, 0, object_count_, sizeof(vk::DrawIndexedIndirectCommand));
+}
@@ -0,0 +1,63 @@
+#ifndef GPU_CULLING_HH_
+#define GPU_CULLING_HH_
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "memory_allocator.hh"
+#include "specialization.hh"
+
+// Frustum culls per-object bounding spheres in a compute pass that writes indexed indirect draw commands, so the CPU cost
+// of drawing stays constant however many objects there are. Object i is drawn as instance i.
+class GpuCulling {
+public:
+    // draw_indirect_count may be null, in which case every object gets a command and culled ones draw zero instances.
+    // Requires the multiDrawIndirect and drawIndirectFirstInstance features.
+    GpuCulling(MemoryAllocator& memory_allocator, vk::PipelineCache pipeline_cache, vk::Buffer bounds_buffer, uint32_t object_count, uint32_t index_count,
+            PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count);
+    // Creates commands for each target image, so recording for an image never races with drawing another one
+    void resize(uint32_t image_count);
+    // Must be recorded outside of the render pass
+    void record_culling(vk::CommandBuffer command_buffer, uint32_t image_index, const std::array<glm::vec4, 4>& frustum_planes) const;
+    // Must be recorded inside the render pass, with the graphics pipeline, vertex and index buffers bound
+    void record_draw(vk::CommandBuffer command_buffer, uint32_t image_index) const;
+
+private:
+    struct PushConstants {
+        std::array<glm::vec4, 4> frustum_planes;
+        uint32_t object_count;
+        uint32_t index_count;
+    };
+
+    // Specialization constants of cull.comp
+    struct CullConstants {
+        VkBool32 compact;
+
+        constexpr static auto get_map_entries() {
+            return std::array<vk::SpecializationMapEntry, 1> {vk::SpecializationMapEntry(0, offsetof(CullConstants, compact), sizeof(VkBool32))};
+        }
+    };
+
+    struct ImageResources {
+        Buffer commands;
+        Buffer count;
+        vk::DescriptorSet descriptor_set;
+    };
+
+    MemoryAllocator& memory_allocator_;
+    const vk::Device device_;
+    const vk::AllocationCallbacks* const allocation_callbacks_;
+    const vk::Buffer bounds_buffer_;
+    const uint32_t object_count_, index_count_;
+    const PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count_;
+    vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+    vk::UniquePipelineLayout pipeline_layout_;
+    vk::UniquePipeline pipeline_;
+    vk::UniqueDescriptorPool descriptor_pool_;
+    std::vector<ImageResources> images_;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "host_allocator.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+const size_t MIN_CLASS_SIZE = 32;
+const size_t MAX_CLASS_SIZE = 4096;
+const size_t CHUNK_SIZE = 64 << 10;
+const size_t ARENA_BLOCK_SIZE = 64 << 10;
+// Arena allocations start after the block's bookkeeping
+const size_t ARENA_DATA_OFFSET = 64;
+const uint8_t LARGE_SOURCE = 0xfe;
+const uint8_t ARENA_SOURCE = 0xff;
+
+size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+// Precedes every returned pointer
+struct HostAllocator::Header {
+    uint64_t size;
+    // From the start of the pool block, system allocation or arena block to the returned pointer
+    uint32_t offset;
+    uint8_t scope;
+    // Size class index, LARGE_SOURCE or ARENA_SOURCE
+    uint8_t source;
+};
+
+struct HostAllocator::ArenaBlock {
+    ArenaBlock* next;
+    ArenaBlock* next_free;
+    uint64_t live_count;
+};
+
+uint64_t HostAllocationStats::allocation_count() const {
+    uint64_t count = 0;
+    for (const auto& scope : scopes)
+        count += scope.allocation_count;
+    return count;
+}
+
+HostAllocator::HostAllocator() :
+    callbacks_(VkAllocationCallbacks{this, allocate_callback, reallocate_callback, free_callback, internal_allocation_callback, internal_free_callback}),
+    swapchain_callbacks_(VkAllocationCallbacks{this, allocate_arena_callback, reallocate_arena_callback, free_callback, internal_allocation_callback, internal_free_callback}) {}
+
+HostAllocator::~HostAllocator() {
+    for (size_t i = 0; i < size_classes_.size(); i++) {
+        const auto class_size = MIN_CLASS_SIZE << i;
+        for (auto chunk = size_classes_[i].chunks; chunk;) {
+            const auto next = *reinterpret_cast<void**>(static_cast<char*>(chunk) + CHUNK_SIZE - class_size);
+            free_to_system(chunk);
+            chunk = next;
+        }
+    }
+    for (auto block = arena_blocks_; block;) {
+        const auto next = block->next;
+        free_to_system(block);
+        block = next;
+    }
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    // The header is right before the returned pointer, which must keep the requested alignment
+    const size_t offset = std::max(alignment, sizeof(Header));
+    const size_t total = offset + size;
+    if (total > MAX_CLASS_SIZE) {
+        const auto memory = allocate_from_system(total, offset);
+        return memory ? place(memory, offset, size, scope, LARGE_SOURCE) : nullptr;
+    }
+
+    // Blocks are aligned to their size, which is at least the alignment
+    uint8_t index = 0;
+    while ((MIN_CLASS_SIZE << index) < total)
+        index++;
+    auto& size_class = size_classes_[index];
+    const std::lock_guard<std::mutex> lock(size_class.mutex);
+    if (!size_class.free_list) {
+        const auto chunk = static_cast<char*>(allocate_from_system(CHUNK_SIZE, MAX_CLASS_SIZE));
+        if (!chunk)
+            return nullptr;
+        // The last block links to the next chunk
+        const auto class_size = MIN_CLASS_SIZE << index;
+        *reinterpret_cast<void**>(chunk + CHUNK_SIZE - class_size) = size_class.chunks;
+        size_class.chunks = chunk;
+        for (size_t block = CHUNK_SIZE - 2 * class_size;; block -= class_size) {
+            *reinterpret_cast<void**>(chunk + block) = size_class.free_list;
+            size_class.free_list = chunk + block;
+            if (!block)
+                break;
+        }
+    }
+    const auto block = size_class.free_list;
+    size_class.free_list = *static_cast<void**>(block);
+    return place(block, offset, size, scope, index);
+}
+
+void* HostAllocator::allocate_from_arena(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    const size_t offset = std::max(alignment, sizeof(Header));
+    if (alignment > ARENA_DATA_OFFSET || ARENA_DATA_OFFSET + offset + size > ARENA_BLOCK_SIZE)
+        return allocate(size, alignment, scope);
+
+    const std::lock_guard<std::mutex> lock(arena_mutex_);
+    auto position = align_up(arena_offset_ + sizeof(Header), offset);
+    if (!arena_block_ || position + size > ARENA_BLOCK_SIZE) {
+        ArenaBlock* block = free_arena_blocks_;
+        if (block) {
+            free_arena_blocks_ = block->next_free;
+        } else {
+            block = static_cast<ArenaBlock*>(allocate_from_system(ARENA_BLOCK_SIZE, ARENA_BLOCK_SIZE));
+            if (!block)
+                return nullptr;
+            block->next = arena_blocks_;
+            block->live_count = 0;
+            arena_blocks_ = block;
+        }
+        // A block left behind is recycled by the last free of its allocations, or right away if it has none
+        if (arena_block_ && !arena_block_->live_count) {
+            arena_block_->next_free = free_arena_blocks_;
+            free_arena_blocks_ = arena_block_;
+        }
+        arena_block_ = block;
+        position = align_up(ARENA_DATA_OFFSET + sizeof(Header), offset);
+    }
+    arena_block_->live_count++;
+    arena_offset_ = position + size;
+    return place(arena_block_, position, size, scope, ARENA_SOURCE);
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope, bool arena) {
+    if (!original)
+        return arena ? allocate_from_arena(size, alignment, scope) : allocate(size, alignment, scope);
+    if (!size) {
+        free(original);
+        return nullptr;
+    }
+    const auto header = static_cast<Header*>(original) - 1;
+    // Grow or shrink in place if the pool block is large enough, the alignment can't change
+    if (header->source < SIZE_CLASS_COUNT && header->offset + size <= MIN_CLASS_SIZE << header->source) {
+        auto& old_counters = scopes_[header->scope];
+        old_counters.live_count.fetch_sub(1, std::memory_order_relaxed);
+        old_counters.live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+        place(static_cast<char*>(original) - header->offset, header->offset, size, scope, header->source);
+        return original;
+    }
+    // The original must stay valid if the allocation fails
+    const auto memory = arena ? allocate_from_arena(size, alignment, scope) : allocate(size, alignment, scope);
+    if (!memory)
+        return nullptr;
+    std::memcpy(memory, original, std::min<size_t>(size, header->size));
+    free(original);
+    return memory;
+}
+
+void HostAllocator::free(void* memory) {
+    if (!memory)
+        return;
+    const auto header = static_cast<Header*>(memory) - 1;
+    auto& counters = scopes_[header->scope];
+    counters.live_count.fetch_sub(1, std::memory_order_relaxed);
+    counters.live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    const auto block = static_cast<char*>(memory) - header->offset;
+
+    if (header->source < SIZE_CLASS_COUNT) {
+        auto& size_class = size_classes_[header->source];
+        const std::lock_guard<std::mutex> lock(size_class.mutex);
+        *reinterpret_cast<void**>(block) = size_class.free_list;
+        size_class.free_list = block;
+    } else if (header->source == LARGE_SOURCE) {
+        reserved_bytes_.fetch_sub(align_up(header->offset + header->size, header->offset), std::memory_order_relaxed);
+        free_to_system(block);
+    } else {
+        const auto arena_block = reinterpret_cast<ArenaBlock*>(block);
+        const std::lock_guard<std::mutex> lock(arena_mutex_);
+        if (--arena_block->live_count)
+            return;
+        if (arena_block == arena_block_) {
+            arena_offset_ = ARENA_DATA_OFFSET;
+        } else {
+            arena_block->next_free = free_arena_blocks_;
+            free_arena_blocks_ = arena_block;
+        }
+    }
+}
+
+void* HostAllocator::allocate_from_system(size_t size, size_t alignment) {
+    const auto rounded_size = align_up(size, alignment);
+#ifdef _WIN32
+    // MSVC has no aligned_alloc, its aligned blocks must go back through _aligned_free
+    const auto memory = _aligned_malloc(rounded_size, alignment);
+#else
+    const auto memory = std::aligned_alloc(alignment, rounded_size);
+#endif
+    if (memory) {
+        system_allocation_count_.fetch_add(1, std::memory_order_relaxed);
+        reserved_bytes_.fetch_add(rounded_size, std::memory_order_relaxed);
+    }
+    return memory;
+}
+
+void HostAllocator::free_to_system(void* memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void* HostAllocator::place(void* block, size_t offset, size_t size, VkSystemAllocationScope scope, uint8_t source) {
+    static_assert(sizeof(Header) == 16);
+    const auto memory = static_cast<char*>(block) + offset;
+    const auto header = reinterpret_cast<Header*>(memory) - 1;
+    header->size = size;
+    header->offset = static_cast<uint32_t>(offset);
+    header->scope = static_cast<uint8_t>(scope);
+    header->source = source;
+    auto& counters = scopes_[scope];
+    counters.live_count.fetch_add(1, std::memory_order_relaxed);
+    counters.live_bytes.fetch_add(size, std::memory_order_relaxed);
+    counters.allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return memory;
+}
+
+HostAllocationStats HostAllocator::get_stats() const {
+    HostAllocationStats stats;
+    for (size_t i = 0; i < scopes_.size(); i++) {
+        stats.scopes[i].live_count = scopes_[i].live_count.load(std::memory_order_relaxed);
+        stats.scopes[i].live_bytes = scopes_[i].live_bytes.load(std::memory_order_relaxed);
+        stats.scopes[i].allocation_count = scopes_[i].allocation_count.load(std::memory_order_relaxed);
+        stats.scopes[i].internal_bytes = scopes_[i].internal_bytes.load(std::memory_order_relaxed);
+    }
+    stats.system_allocation_count = system_allocation_count_.load(std::memory_order_relaxed);
+    stats.reserved_bytes = reserved_bytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void HostAllocator::print_stats(std::ostream& stream) const {
+    const auto stats = get_stats();
+    stream << "Host memory: " << stats.allocation_count() << " driver allocations, " << stats.reserved_bytes << " bytes reserved in "
+           << stats.system_allocation_count << " system allocations\n";
+    for (size_t i = 0; i < stats.scopes.size(); i++) {
+        const auto& scope = stats.scopes[i];
+        stream << "\t" << vk::to_string(static_cast<vk::SystemAllocationScope>(i)) << ": " << scope.live_count << " live allocations of "
+               << scope.live_bytes << " bytes, " << scope.allocation_count << " in total, " << scope.internal_bytes << " internal bytes\n";
+    }
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocate_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator*>(user_data)->allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocate_arena_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator*>(user_data)->allocate_from_arena(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocate_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator*>(user_data)->reallocate(original, size, alignment, scope, false);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocate_arena_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator*>(user_data)->reallocate(original, size, alignment, scope, true);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::free_callback(void* user_data, void* memory) {
+    static_cast<HostAllocator*>(user_data)->free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<HostAllocator*>(user_data)->scopes_[scope].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internal_free_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<HostAllocator*>(user_data)->scopes_[scope].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
@@ -0,0 +1,103 @@
+#ifndef HOST_ALLOCATOR_HH_
+#define HOST_ALLOCATOR_HH_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+#include <vulkan/vulkan.hpp>
+
+// Indexed by VkSystemAllocationScope, command to instance
+const size_t HOST_ALLOCATION_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+struct HostScopeStats {
+    uint64_t live_count = 0;
+    uint64_t live_bytes = 0;
+    // Every allocation and reallocation since creation
+    uint64_t allocation_count = 0;
+    // Memory the driver allocated by itself and reported, e.g. executable code
+    uint64_t internal_bytes = 0;
+};
+
+struct HostAllocationStats {
+    std::array<HostScopeStats, HOST_ALLOCATION_SCOPE_COUNT> scopes;
+    // Pool chunks, arena blocks and large allocations requested from malloc
+    uint64_t system_allocation_count = 0;
+    uint64_t reserved_bytes = 0;
+
+    [[nodiscard]] uint64_t allocation_count() const;
+};
+
+// Host memory allocator for the driver. Requests up to 4 KiB come from size class pools carved out of 64 KiB chunks, larger
+// ones go to malloc. Objects living as long as a swapchain are bump allocated from an arena instead, whose blocks are reused
+// once everything allocated from them was freed, so recreating the swapchain stops reaching malloc after the first time.
+// Chunks and blocks are only returned to the system on destruction. Thread safe.
+// Must outlive every object created with its callbacks, since they are needed again to destroy it.
+class HostAllocator {
+public:
+    HostAllocator();
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+    ~HostAllocator();
+
+    [[nodiscard]] const vk::AllocationCallbacks* callbacks() const { return &callbacks_; }
+    // For the swapchain and the objects recreated along with it
+    [[nodiscard]] const vk::AllocationCallbacks* swapchain_callbacks() const { return &swapchain_callbacks_; }
+    [[nodiscard]] HostAllocationStats get_stats() const;
+    void print_stats(std::ostream& stream) const;
+
+private:
+    struct Header;
+    struct SizeClass {
+        std::mutex mutex;
+        // Intrusive list through the free blocks
+        void* free_list = nullptr;
+        // Intrusive list through the last block of each chunk
+        void* chunks = nullptr;
+    };
+    struct ArenaBlock;
+    struct ScopeCounters {
+        std::atomic<uint64_t> live_count{0};
+        std::atomic<uint64_t> live_bytes{0};
+        std::atomic<uint64_t> allocation_count{0};
+        std::atomic<uint64_t> internal_bytes{0};
+    };
+
+    static const size_t SIZE_CLASS_COUNT = 8;
+
+    const vk::AllocationCallbacks callbacks_;
+    const vk::AllocationCallbacks swapchain_callbacks_;
+    std::array<SizeClass, SIZE_CLASS_COUNT> size_classes_;
+    std::mutex arena_mutex_;
+    ArenaBlock* arena_block_ = nullptr;
+    size_t arena_offset_ = 0;
+    // Blocks without live allocations, other than the current one
+    ArenaBlock* free_arena_blocks_ = nullptr;
+    // Every block, for destruction
+    ArenaBlock* arena_blocks_ = nullptr;
+    std::array<ScopeCounters, HOST_ALLOCATION_SCOPE_COUNT> scopes_;
+    std::atomic<uint64_t> system_allocation_count_{0};
+    std::atomic<uint64_t> reserved_bytes_{0};
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* allocate_from_arena(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope, bool arena);
+    void free(void* memory);
+    void* allocate_from_system(size_t size, size_t alignment);
+    // Releases a block from allocate_from_system()
+    static void free_to_system(void* memory);
+    // Writes the header of an allocation offset bytes into block and counts it
+    void* place(void* block, size_t offset, size_t size, VkSystemAllocationScope scope, uint8_t source);
+
+    static VKAPI_ATTR void* VKAPI_CALL allocate_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL allocate_arena_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocate_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocate_arena_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL free_callback(void* user_data, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL internal_free_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
+
+#endif
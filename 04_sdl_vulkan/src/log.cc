@@ -1,37 +1,157 @@
-#ifdef REDIRECT_STD_STREAMS_TO_SDL
-/*
-https://wiki.libsdl.org/SDL_Log
-http://www.cplusplus.com/reference/iostream/clog/
-http://www.cplusplus.com/reference/ios/ios/rdbuf/
-http://www.cplusplus.com/reference/streambuf/streambuf/
-https://stackoverflow.com/questions/14086417/how-to-write-custom-input-stream-in-c
-https://stackoverflow.com/questions/23726848/inherit-from-stdostringstream
-https://stackoverflow.com/questions/27368897/simplest-way-to-create-class-that-behaves-like-stringstream?lq=1
-https://github.com/tcbrindle/sdlxx/blob/master/include/sdl%2B%2B/log.hpp
-*/
+#include "log.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 #include <SDL2/SDL.h>
 
-class SdlLogRedirect {
-public:
-    SdlLogRedirect() {
+namespace {
+// How long logged messages may wait in the ring before being written
+const auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
 
+SDL_LogPriority sdl_priority(LogLevel level) {
+    switch (level) {
+    case LogLevel::debug:
+        return SDL_LOG_PRIORITY_DEBUG;
+    case LogLevel::info:
+        return SDL_LOG_PRIORITY_INFO;
+    case LogLevel::warning:
+        return SDL_LOG_PRIORITY_WARN;
+    case LogLevel::error:
+        break;
     }
+    return SDL_LOG_PRIORITY_ERROR;
+}
 
-    ~SdlLogRedirect() {
-
+const char* level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::debug:
+        return "DEBUG";
+    case LogLevel::info:
+        return "INFO";
+    case LogLevel::warning:
+        return "WARN";
+    case LogLevel::error:
+        break;
     }
+    return "ERROR";
+}
+}
+
+void LogMessage::append(std::string_view text) {
+    const auto size = std::min(text.size(), CAPACITY - size_);
+    std::memcpy(text_.data() + size_, text.data(), size);
+    size_ += size;
+}
 
-private:
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
 
-};
+Logger::Logger() : slots_(std::make_unique<Slot[]>(SLOT_COUNT)) {
+    for (size_t i = 0; i < SLOT_COUNT; i++)
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    // SDL_Log filters out debug messages by default, the compile-time level decides instead
+    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG);
+    thread_ = std::thread(&Logger::drain, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
 
-class BlahStream {
-    void coisa() {
-        SDL_Log("%s", "test");
+void Logger::push(LogLevel level, const LogMessage& message) {
+    const auto time = Clock::now();
+    auto position = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots_[position % SLOT_COUNT];
+        const auto sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (sequence < position) {
+            // Still holds the message from a lap ago, the ring is full
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = tail_.load(std::memory_order_relaxed);
+        }
     }
-};
+    slot->time = time;
+    slot->level = level;
+    slot->message = message;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    // Bursts would overflow the ring before the next periodic drain. Notifying costs a system call, so only do it a few
+    // times per lap.
+    if (position % (SLOT_COUNT / 4) == 0)
+        wake_.notify_one();
+}
 
-// static SdlLogRedirect sdl_log_redirect;
+void Logger::flush() {
+    std::unique_lock lock(mutex_);
+    const auto request = ++flush_requests_;
+    wake_.notify_one();
+    flushed_.wait(lock, [&] { return flushes_done_ >= request; });
+}
 
-#endif
+void Logger::open_file(const std::string& path) {
+    std::lock_guard lock(mutex_);
+    file_.open(path, std::ios::out | std::ios::trunc);
+    if (!file_)
+        throw std::runtime_error("Failed to open log file " + path);
+}
+
+void Logger::drain() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        // Messages pushed before these requests are in the ring by now
+        const auto flush_requests = flush_requests_;
+        const bool stopping = stopping_;
+        for (;;) {
+            auto& slot = slots_[head_ % SLOT_COUNT];
+            if (slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+                break;
+            write(slot.time, slot.level, slot.message.view());
+            slot.sequence.store(head_ + SLOT_COUNT, std::memory_order_release);
+            head_++;
+        }
+        if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed)) {
+            LogMessage message;
+            message.append("Log ring full, dropped ");
+            message.append(dropped);
+            message.append(" messages");
+            write(Clock::now(), LogLevel::warning, message.view());
+        }
+        if (file_.is_open())
+            file_.flush();
+        flushes_done_ = flush_requests;
+        flushed_.notify_all();
+        if (stopping)
+            return;
+        // Spurious wake ups only cause an early drain
+        if (!stopping_ && flush_requests_ == flushes_done_)
+            wake_.wait_for(lock, DRAIN_INTERVAL);
+    }
+}
+
+void Logger::write(Clock::time_point time, LogLevel level, std::string_view text) {
+    if (file_.is_open()) {
+        const std::chrono::duration<double> elapsed = time - start_;
+        LogMessage prefix;
+        prefix.append(elapsed.count());
+        prefix.append(' ');
+        prefix.append(level_name(level));
+        prefix.append(' ');
+        file_ << prefix.view() << text << '\n';
+    } else {
+        SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, sdl_priority(level), "%.*s", static_cast<int>(text.size()), text.data());
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef LOG_HH_
+#define LOG_HH_
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel {
+    debug,
+    info,
+    warning,
+    error,
+};
+
+// Messages below this level are compiled out, e.g. -DLOG_MIN_LEVEL=2 only keeps warnings and errors
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+constexpr LogLevel MIN_LOG_LEVEL = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+// Fixed size text the arguments of a log call are formatted into, without allocating. Longer messages are truncated.
+class LogMessage {
+public:
+    static constexpr size_t CAPACITY = 224;
+
+    void append(std::string_view text);
+    void append(const char* text) { append(std::string_view(text)); }
+    void append(const std::string& text) { append(std::string_view(text)); }
+    void append(char c) { append(std::string_view(&c, 1)); }
+    void append(bool value) { append(value ? "true" : "false"); }
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    void append(T value) {
+        size_ = std::to_chars(text_.data() + size_, text_.data() + CAPACITY, value).ptr - text_.data();
+    }
+
+    template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    void append(T value) {
+        const auto result = std::to_chars(text_.data() + size_, text_.data() + CAPACITY, value, std::chars_format::fixed, 3);
+        if (result.ec == std::errc())
+            size_ = result.ptr - text_.data();
+    }
+
+    [[nodiscard]] std::string_view view() const { return {text_.data(), size_}; }
+
+private:
+    size_t size_ = 0;
+    std::array<char, CAPACITY> text_;
+};
+
+// Producers format their message on their own stack and copy it into a lock-free ring, so logging costs no system
+// calls and never blocks. A thread drains the ring to SDL_Log, or to a file if one was opened. Messages are dropped,
+// and counted, if the ring is full.
+class Logger {
+public:
+    static Logger& instance();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void push(LogLevel level, const LogMessage& message);
+    // Blocks until every message pushed before the call was written
+    void flush();
+    // Writes to this file instead of SDL_Log from now on
+    void open_file(const std::string& path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct alignas(64) Slot {
+        // Equal to the slot's position when free, position + 1 once written
+        std::atomic<size_t> sequence;
+        Clock::time_point time;
+        LogLevel level;
+        LogMessage message;
+    };
+
+    static constexpr size_t SLOT_COUNT = 1024;
+
+    const Clock::time_point start_ = Clock::now();
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::atomic<size_t> dropped_{0};
+    // Only used by the drain thread
+    alignas(64) size_t head_ = 0;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    uint64_t flush_requests_ = 0;
+    uint64_t flushes_done_ = 0;
+    bool stopping_ = false;
+    std::ofstream file_;
+    std::thread thread_;
+
+    Logger();
+    ~Logger();
+    void drain();
+    void write(Clock::time_point time, LogLevel level, std::string_view text);
+};
+
+template <LogLevel level, typename... Args>
+void log(const Args&... args) {
+    if constexpr (level >= MIN_LOG_LEVEL) {
+        LogMessage message;
+        (message.append(args), ...);
+        Logger::instance().push(level, message);
+    }
+}
+
+template <typename... Args>
+void log_debug(const Args&... args) { log<LogLevel::debug>(args...); }
+
+template <typename... Args>
+void log_info(const Args&... args) { log<LogLevel::info>(args...); }
+
+template <typename... Args>
+void log_warning(const Args&... args) { log<LogLevel::warning>(args...); }
+
+template <typename... Args>
+void log_error(const Args&... args) { log<LogLevel::error>(args...); }
+
+#endif
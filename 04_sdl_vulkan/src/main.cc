@@ -1,47 +1,271 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
 #include <vector>
 
+#include "allocation_counter.hh"
+#include "frame_limiter.hh"
+#include "log.hh"
+#include "options.hh"
 #include "quit_exception.hh"
+#include "redraw_scheduler.hh"
 #include "sdl_window.hh"
+#include "spsc_queue.hh"
 #include "vulkan.hh"
 
+// How often the event thread checks whether the render thread stopped
+const int EVENT_WAIT_TIMEOUT_MS = 100;
+// On-demand rendering is throttled down to this interval after this long without input
+const auto IDLE_FRAME_INTERVAL = std::chrono::seconds(1);
+const auto IDLE_DELAY = std::chrono::seconds(2);
+
 class App {
 private:
-    SDLWindow window_;
+    const Options options_;
+    // Null in headless mode
+    const std::unique_ptr<SDLWindow> window_;
+    // Set once a render thread is started. SDL must then only be used by the main thread, which forwards window
+    // events to the render thread along with the drawable size.
+    bool forwarding_events_ = false;
+    SpscQueue<WindowEvent, 256> window_events_;
+    std::pair<int, int> forwarded_extent_;
     Vulkan vulkan_;
 
 public:
-    App() : vulkan_(window_.get_vulkan_extensions(), [this]() {return window_.get_drawable_size();}, SDLWindow::wait_window_show_event) {}
+    explicit App(const Options& options) :
+        options_(options),
+        window_(options.headless ? nullptr : std::make_unique<SDLWindow>()),
+        forwarded_extent_(window_ ? window_->get_drawable_size() : std::pair<int, int>()),
+        vulkan_(options, window_ ? window_->get_vulkan_extensions() : std::vector<const char*>(),
+                [this]() { return forwarding_events_ ? forwarded_extent_ : window_->get_drawable_size(); },
+                [this]() { forwarding_events_ ? handle_window_event(window_events_.wait_pop()) : SDLWindow::wait_window_show_event(); }) {}
+
+    ~App() {
+        try {
+            report_profile();
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to write profile: " << e.what() << "\n";
+        }
+    }
 
     void run() {
-        const auto surface = window_.create_vulkan_surface(vulkan_.get_instance());
-        vulkan_.initialize(surface);
-        main_loop();
+        const auto start = std::chrono::steady_clock::now();
+        if (window_) {
+            const auto surface = window_->create_vulkan_surface(vulkan_.get_instance());
+            vulkan_.initialize(surface);
+        } else {
+            vulkan_.initialize_headless();
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Initialized in " << elapsed.count() << " ms with a " << (vulkan_.is_pipeline_cache_warm() ? "warm" : "cold") << " pipeline cache\n";
+        vulkan_.get_memory_allocator().print_stats(std::cout);
+        vulkan_.get_host_allocator().print_stats(std::cout);
+        if (options_.upload_benchmark_mib)
+            vulkan_.benchmark_uploads(vk::DeviceSize(options_.upload_benchmark_mib) << 20);
+        else if (options_.benchmark_frames)
+            benchmark();
+        else
+            main_loop();
+    }
+
+    void benchmark() {
+        // Frames are measured with everything drawn
+        vulkan_.wait_for_pipelines();
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < options_.benchmark_frames; i++) {
+            if (options_.assert_zero_allocations && i == ZERO_ALLOCATION_WARMUP_FRAMES)
+                start_counting_allocations();
+            if (window_)
+                window_->poll_events();
+            step();
+        }
+        const auto allocations = options_.assert_zero_allocations ? stop_counting_allocations() : 0;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << options_.benchmark_frames << " frames in " << elapsed.count() << " s, "
+                  << options_.benchmark_frames / elapsed.count() << " frames/s with " << options_.frames_in_flight << " frames in flight and "
+                  << options_.instance_count << " instances of " << vulkan_.get_vertex_count() << " vertices at " << vulkan_.get_vertex_size() << " bytes per vertex\n";
+        if (options_.assert_zero_allocations) {
+            std::cout << allocations << " heap allocations in " << options_.benchmark_frames - ZERO_ALLOCATION_WARMUP_FRAMES << " frames after the warm-up\n";
+            if (allocations)
+                throw std::runtime_error("Frames allocated heap memory");
+        }
+    }
+
+    void report_profile() const {
+        const auto profiler = vulkan_.get_profiler();
+        if (!profiler)
+            return;
+        profiler->write_summary(std::cout);
+        const auto write = [](const std::string& path, auto writer) {
+            if (path.empty())
+                return;
+            std::ofstream stream(path);
+            writer(stream);
+            if (!stream)
+                throw std::runtime_error("Failed to write " + path);
+        };
+        write(options_.profile_csv_path, [profiler](std::ostream& stream) { profiler->write_csv(stream); });
+        write(options_.profile_json_path, [profiler](std::ostream& stream) { profiler->write_json(stream); });
     }
 
     void main_loop() {
+        if (window_ && options_.render_thread)
+            threaded_loop();
+        else if (options_.loop_mode == LoopMode::continuous)
+            continuous_loop();
+        else if (window_ && options_.loop_mode == LoopMode::on_demand)
+            on_demand_loop();
+        else
+            wait_loop();
+    }
+
+    void wait_loop() {
+        // A frame drawn while the render target was outdated may not have been shown, it is drawn again without waiting
+        bool shown = true;
+        for (;;) {
+            if (!shown || !window_ || window_->pool())
+                shown = step();
+        }
+    }
+
+    void continuous_loop() {
+        std::optional<FrameLimiter> frame_limiter;
+        if (options_.fps_limit)
+            frame_limiter.emplace(options_.fps_limit);
+        for (;;) {
+            if (window_)
+                window_->poll_events();
+            step();
+            if (frame_limiter)
+                frame_limiter->wait();
+        }
+    }
+
+    // Sleeps in the event queue until the window or the render target needs a new frame
+    void on_demand_loop() {
+        using Clock = RedrawScheduler::Clock;
+        const auto active_interval = options_.fps_limit ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / options_.fps_limit)) : Clock::duration::zero();
+        RedrawScheduler scheduler(active_interval, IDLE_FRAME_INTERVAL, IDLE_DELAY);
+        for (;;) {
+            const auto timeout = scheduler.time_until_frame(Clock::now());
+            // Rounded up, waking up before the frame is due would only spin
+            auto event = window_->wait_event(timeout ? static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(*timeout).count()) : -1);
+            for (; event; event = window_->wait_event(0)) {
+                switch (event->type) {
+                case WindowEvent::Type::quit:
+                    throw quit_exception();
+                case WindowEvent::Type::resize:
+                    vulkan_.request_render_target_recreation();
+                    scheduler.invalidate();
+                    break;
+                case WindowEvent::Type::expose:
+                    scheduler.invalidate();
+                    break;
+                case WindowEvent::Type::input:
+                    scheduler.input(Clock::now());
+                    break;
+                }
+            }
+            // A frame drawn while the render target was outdated may not have been shown
+            if (scheduler.begin_frame(Clock::now()) && !vulkan_.draw_frame())
+                scheduler.invalidate();
+        }
+    }
+
+    // Handles window events on the main thread and renders on another one, so stalls in event handling (e.g. while the
+    // window is dragged) don't delay frames
+    void threaded_loop() {
+        std::exception_ptr render_exception;
+        std::atomic<bool> rendering = true;
+        forwarding_events_ = true;
+        std::thread render_thread([&] {
+            try {
+                render_loop();
+            } catch (...) {
+                render_exception = std::current_exception();
+            }
+            rendering = false;
+        });
+        // The render thread stops after receiving a quit event, or on errors
+        while (rendering) {
+            const auto event = window_->wait_event(EVENT_WAIT_TIMEOUT_MS);
+            // The render thread doesn't throttle on input
+            if (!event || event->type == WindowEvent::Type::input)
+                continue;
+            // The render thread drains the queue every frame, it can only be full for a moment
+            while (!window_events_.push(*event) && rendering)
+                std::this_thread::yield();
+            if (event->type == WindowEvent::Type::quit)
+                break;
+        }
+        render_thread.join();
+        if (render_exception)
+            std::rethrow_exception(render_exception);
+    }
+
+    void render_loop() {
+        std::optional<FrameLimiter> frame_limiter;
+        if (options_.fps_limit)
+            frame_limiter.emplace(options_.fps_limit);
+        bool shown = true;
         for (;;) {
-        // while (window_.pool()) {
-            if (window_.pool())
-                step();
+            // In wait mode, every event triggers a frame, as does a frame that may not have been shown
+            if (options_.loop_mode == LoopMode::wait && shown)
+                handle_window_event(window_events_.wait_pop());
+            while (const auto event = window_events_.pop())
+                handle_window_event(*event);
+            shown = step();
+            if (frame_limiter)
+                frame_limiter->wait();
         }
     }
 
-    void step() {
-        vulkan_.draw_frame();
+    // Render thread only
+    void handle_window_event(const WindowEvent& event) {
+        switch (event.type) {
+        case WindowEvent::Type::quit:
+            throw quit_exception();
+        case WindowEvent::Type::resize:
+            forwarded_extent_ = {event.width, event.height};
+            vulkan_.request_render_target_recreation();
+            break;
+        case WindowEvent::Type::expose:
+        case WindowEvent::Type::input:
+            break;
+        }
+    }
+
+    // Returns false if the frame may not have been shown
+    bool step() {
+        return vulkan_.draw_frame();
     }
 };
 
-int main(int, char **) {
+int main(int argc, char **argv) {
     try {
-        App app;
+        const auto options = parse_options(argc, argv);
+        if (!options.log_file_path.empty())
+            Logger::instance().open_file(options.log_file_path);
+        App app(options);
         app.run();
     } catch (const quit_exception& e) {
 
+    } catch (const options_error& e) {
+        std::cerr << e.what() << "\n";
+        print_usage(std::cerr);
+        return 1;
+
     } catch (const std::runtime_error& e) {
+        // Let pending messages explain what led to the error
+        Logger::instance().flush();
         std::cerr << "Runtime error: " << e.what() << std::endl;
         throw;
     } catch (const std::exception& e) {
@@ -0,0 +1,239 @@
+#include "memory_allocator.hh"
+
+#include <algorithm>
+
+namespace {
+const vk::DeviceSize DEFAULT_BLOCK_SIZE = 64 << 20;
+const vk::DeviceSize MIN_BLOCK_SIZE = 1 << 20;
+const vk::DeviceSize MIN_BUDDY_SIZE = 256;
+
+vk::DeviceSize round_up_to_power_of_two(vk::DeviceSize value) {
+    vk::DeviceSize result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+uint32_t log2(vk::DeviceSize value) {
+    uint32_t result = 0;
+    while (value >>= 1)
+        result++;
+    return result;
+}
+}
+
+UniqueAllocation& UniqueAllocation::operator=(UniqueAllocation&& other) noexcept {
+    if (this != &other) {
+        reset();
+        allocator_ = other.allocator_;
+        allocation_ = other.allocation_;
+        other.allocator_ = nullptr;
+    }
+    return *this;
+}
+
+void UniqueAllocation::reset() {
+    if (allocator_)
+        allocator_->free(allocation_);
+    allocator_ = nullptr;
+}
+
+MemoryAllocator::MemoryAllocator(vk::PhysicalDevice physical_device, vk::Device device, const vk::AllocationCallbacks* allocation_callbacks) :
+    physical_device_(physical_device), device_(device), allocation_callbacks_(allocation_callbacks),
+    max_device_memory_count_(physical_device.getProperties().limits.maxMemoryAllocationCount),
+    min_size_(std::max(MIN_BUDDY_SIZE, round_up_to_power_of_two(physical_device.getProperties().limits.bufferImageGranularity))) {
+    const auto memory_properties = physical_device.getMemoryProperties();
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        const auto& memory_type = memory_properties.memoryTypes[i];
+        // Small heaps (e.g. 256 MiB device local and host visible) get smaller blocks so a single block can't exhaust them
+        auto block_size = DEFAULT_BLOCK_SIZE;
+        while (block_size > MIN_BLOCK_SIZE && block_size > memory_properties.memoryHeaps[memory_type.heapIndex].size / 8)
+            block_size >>= 1;
+        memory_types_.push_back({memory_type.propertyFlags, block_size, log2(block_size / min_size_), {}});
+    }
+}
+
+Allocation MemoryAllocator::allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    // First pass only accepts types with the preferred flags, the second any type with the required ones
+    for (const auto wanted : {required | preferred, required}) {
+        for (uint32_t i = 0; i < memory_types_.size(); i++) {
+            if (!(requirements.memoryTypeBits & (1u << i)) || (memory_types_[i].properties & wanted) != wanted)
+                continue;
+            try {
+                if (const auto allocation = allocate_from_type(i, requirements.size, requirements.alignment))
+                    return *allocation;
+            } catch (const vk::OutOfDeviceMemoryError&) {
+                // The heap is full, try the next type
+            }
+        }
+    }
+    throw std::runtime_error("Failed to allocate " + std::to_string(requirements.size) + " bytes of device memory");
+}
+
+std::optional<Allocation> MemoryAllocator::allocate_from_type(uint32_t memory_type_index, vk::DeviceSize size, vk::DeviceSize alignment) {
+    auto& memory_type = memory_types_[memory_type_index];
+    if (size > memory_type.block_size / 2) {
+        const auto block_index = create_block(memory_type_index, size, true);
+        auto& block = memory_type.blocks[block_index];
+        block.used = block.requested = size;
+        block.allocation_count = 1;
+        return Allocation{*block.memory, 0, size, block.mapped, memory_type_index, block_index, 0};
+    }
+
+    // Buddies are aligned to their size, so rounding up to the alignment satisfies it
+    const auto buddy_size = round_up_to_power_of_two(std::max({size, alignment, min_size_}));
+    const auto order = log2(buddy_size / min_size_);
+    auto try_block = [&](uint32_t block_index) -> std::optional<Allocation> {
+        auto& block = memory_type.blocks[block_index];
+        const auto offset = allocate_buddy(block, order);
+        if (!offset)
+            return std::nullopt;
+        block.used += buddy_size;
+        block.requested += size;
+        block.allocation_count++;
+        void* mapped = block.mapped ? static_cast<char*>(block.mapped) + *offset : nullptr;
+        return Allocation{*block.memory, *offset, size, mapped, memory_type_index, block_index, order};
+    };
+    for (uint32_t i = 0; i < memory_type.blocks.size(); i++) {
+        if (!memory_type.blocks[i].free_lists.empty()) {
+            if (auto allocation = try_block(i))
+                return allocation;
+        }
+    }
+    return try_block(create_block(memory_type_index, memory_type.block_size, false));
+}
+
+std::optional<vk::DeviceSize> MemoryAllocator::allocate_buddy(Block& block, uint32_t order) {
+    auto available = order;
+    while (available < block.free_lists.size() && block.free_lists[available].empty())
+        available++;
+    if (available == block.free_lists.size())
+        return std::nullopt;
+
+    const auto offset = *block.free_lists[available].begin();
+    block.free_lists[available].erase(block.free_lists[available].begin());
+    // Split until the buddy has the requested size, freeing the upper halves
+    while (available > order) {
+        available--;
+        block.free_lists[available].insert(offset + (min_size_ << available));
+    }
+    return offset;
+}
+
+uint32_t MemoryAllocator::create_block(uint32_t memory_type_index, vk::DeviceSize size, bool dedicated) {
+    if (device_memory_count_ >= max_device_memory_count_)
+        throw std::runtime_error("maxMemoryAllocationCount reached");
+    auto& memory_type = memory_types_[memory_type_index];
+    Block block;
+    block.memory = device_.allocateMemoryUnique(vk::MemoryAllocateInfo(size, memory_type_index), allocation_callbacks_);
+    block.size = size;
+    if (memory_type.properties & vk::MemoryPropertyFlagBits::eHostVisible)
+        block.mapped = device_.mapMemory(*block.memory, 0, VK_WHOLE_SIZE);
+    if (!dedicated) {
+        block.free_lists.resize(memory_type.max_order + 1);
+        block.free_lists[memory_type.max_order].insert(0);
+    }
+    device_memory_count_++;
+
+    // Reuse the slot of a released block if there is one
+    const auto empty = std::find_if(memory_type.blocks.begin(), memory_type.blocks.end(), [](const Block& block) { return !block.memory; });
+    if (empty != memory_type.blocks.end()) {
+        *empty = std::move(block);
+        return empty - memory_type.blocks.begin();
+    }
+    memory_type.blocks.push_back(std::move(block));
+    return memory_type.blocks.size() - 1;
+}
+
+void MemoryAllocator::free(const Allocation& allocation) {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    auto& block = memory_types_[allocation.memory_type].blocks[allocation.block];
+    block.allocation_count--;
+    block.requested -= allocation.size;
+    if (!block.free_lists.empty()) {
+        block.used -= min_size_ << allocation.order;
+        // Merge with free buddies as far up as possible
+        auto offset = allocation.offset;
+        auto order = allocation.order;
+        for (; order + 1 < block.free_lists.size(); order++) {
+            const auto buddy = offset ^ (min_size_ << order);
+            const auto buddy_iterator = block.free_lists[order].find(buddy);
+            if (buddy_iterator == block.free_lists[order].end())
+                break;
+            block.free_lists[order].erase(buddy_iterator);
+            offset = std::min(offset, buddy);
+        }
+        block.free_lists[order].insert(offset);
+    } else {
+        block.used = 0;
+    }
+
+    if (!block.allocation_count) {
+        // Keep one empty block per memory type, so a resource freed and recreated right away (e.g. with the swapchain)
+        // doesn't reach vkFreeMemory and vkAllocateMemory every time
+        const auto& blocks = memory_types_[allocation.memory_type].blocks;
+        const auto other_empty_block = std::any_of(blocks.begin(), blocks.end(), [&](const Block& other) {
+            return &other != &block && other.memory && !other.free_lists.empty() && !other.allocation_count;
+        });
+        if (!block.free_lists.empty() && !other_empty_block)
+            return;
+        // Freeing the memory also unmaps it
+        block = Block();
+        device_memory_count_--;
+    }
+}
+
+Buffer MemoryAllocator::create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) {
+    Buffer buffer;
+    buffer.buffer = device_.createBufferUnique(vk::BufferCreateInfo({}, size, usage, vk::SharingMode::eExclusive), allocation_callbacks_);
+    const auto allocation = allocate(device_.getBufferMemoryRequirements(*buffer.buffer), required, preferred);
+    buffer.allocation = UniqueAllocation(*this, allocation);
+    device_.bindBufferMemory(*buffer.buffer, allocation.memory, allocation.offset);
+    return buffer;
+}
+
+Image MemoryAllocator::create_image(const vk::ImageCreateInfo& create_info, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) {
+    Image image;
+    image.image = device_.createImageUnique(create_info, allocation_callbacks_);
+    const auto allocation = allocate(device_.getImageMemoryRequirements(*image.image), required, preferred);
+    image.allocation = UniqueAllocation(*this, allocation);
+    device_.bindImageMemory(*image.image, allocation.memory, allocation.offset);
+    return image;
+}
+
+MemoryStats MemoryAllocator::get_stats() const {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    MemoryStats stats;
+    stats.device_memory_count = device_memory_count_;
+    vk::DeviceSize total_free = 0;
+    // Free bytes outside the largest free range of their block
+    vk::DeviceSize scattered_free = 0;
+    for (const auto& memory_type : memory_types_) {
+        for (const auto& block : memory_type.blocks) {
+            if (!block.memory)
+                continue;
+            stats.allocation_count += block.allocation_count;
+            stats.reserved_bytes += block.size;
+            stats.used_bytes += block.used;
+            stats.requested_bytes += block.requested;
+            const auto free_bytes = block.size - block.used;
+            total_free += free_bytes;
+            for (uint32_t order = block.free_lists.size(); order-- > 0;) {
+                if (!block.free_lists[order].empty()) {
+                    scattered_free += free_bytes - (min_size_ << order);
+                    break;
+                }
+            }
+        }
+    }
+    stats.fragmentation = total_free ? static_cast<float>(scattered_free) / total_free : 0.f;
+    return stats;
+}
+
+void MemoryAllocator::print_stats(std::ostream& stream) const {
+    const auto stats = get_stats();
+    stream << "Device memory: " << stats.allocation_count << " allocations in " << stats.device_memory_count << " blocks, "
+           << stats.requested_bytes << " bytes requested, " << stats.used_bytes << " used, " << stats.reserved_bytes << " reserved, "
+           << stats.fragmentation * 100 << "% fragmentation\n";
+}
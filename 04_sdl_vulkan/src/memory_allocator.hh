@@ -0,0 +1,134 @@
+#ifndef MEMORY_ALLOCATOR_HH_
+#define MEMORY_ALLOCATOR_HH_
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// A range of a vk::DeviceMemory handed out by MemoryAllocator
+struct Allocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    // Host address of offset if the memory is host visible, otherwise null
+    void* mapped = nullptr;
+    // Bookkeeping for MemoryAllocator::free
+    uint32_t memory_type = 0;
+    uint32_t block = 0;
+    uint32_t order = 0;
+
+    explicit operator bool() const { return static_cast<bool>(memory); }
+};
+
+struct MemoryStats {
+    // vk::DeviceMemory objects, bounded by maxMemoryAllocationCount
+    uint32_t device_memory_count = 0;
+    uint32_t allocation_count = 0;
+    vk::DeviceSize reserved_bytes = 0;
+    // Bytes handed out, including rounding to buddy sizes
+    vk::DeviceSize used_bytes = 0;
+    // Bytes requested by resources
+    vk::DeviceSize requested_bytes = 0;
+    // 1 - largest free range / free bytes of each block, weighted by its free bytes. 0 if the free space of every block is
+    // contiguous, since separate blocks can't serve one allocation anyway
+    float fragmentation = 0;
+};
+
+class MemoryAllocator;
+
+// Frees its allocation on destruction
+class UniqueAllocation {
+public:
+    UniqueAllocation() = default;
+    UniqueAllocation(MemoryAllocator& allocator, const Allocation& allocation) : allocator_(&allocator), allocation_(allocation) {}
+    UniqueAllocation(UniqueAllocation&& other) noexcept : allocator_(other.allocator_), allocation_(other.allocation_) { other.allocator_ = nullptr; }
+    UniqueAllocation& operator=(UniqueAllocation&& other) noexcept;
+    ~UniqueAllocation() { reset(); }
+
+    const Allocation& operator*() const { return allocation_; }
+    const Allocation* operator->() const { return &allocation_; }
+    explicit operator bool() const { return allocator_; }
+    void reset();
+
+private:
+    MemoryAllocator* allocator_ = nullptr;
+    Allocation allocation_;
+};
+
+struct Buffer {
+    // Destroyed before its memory
+    UniqueAllocation allocation;
+    vk::UniqueBuffer buffer;
+};
+
+struct Image {
+    UniqueAllocation allocation;
+    vk::UniqueImage image;
+};
+
+// Sub-allocates device memory from large per memory type blocks using a buddy allocator, so the number of vk::DeviceMemory
+// objects stays far below maxMemoryAllocationCount. Requests larger than half a block get a dedicated vk::DeviceMemory.
+// Each memory type keeps one empty block instead of releasing it.
+// Thread safe.
+class MemoryAllocator {
+public:
+    // allocation_callbacks is used for every object created through the allocator and may be null
+    MemoryAllocator(vk::PhysicalDevice physical_device, vk::Device device, const vk::AllocationCallbacks* allocation_callbacks);
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // Host visible memory is persistently mapped. Memory types with the preferred flags are tried first.
+    Allocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {});
+    void free(const Allocation& allocation);
+
+    Buffer create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {});
+    Image create_image(const vk::ImageCreateInfo& create_info, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {});
+
+    [[nodiscard]] vk::PhysicalDevice get_physical_device() const { return physical_device_; }
+    [[nodiscard]] vk::Device get_device() const { return device_; }
+    [[nodiscard]] const vk::AllocationCallbacks* get_allocation_callbacks() const { return allocation_callbacks_; }
+    [[nodiscard]] MemoryStats get_stats() const;
+    void print_stats(std::ostream& stream) const;
+
+private:
+    struct Block {
+        vk::UniqueDeviceMemory memory;
+        vk::DeviceSize size = 0;
+        void* mapped = nullptr;
+        // Free offsets for each buddy order, empty for dedicated blocks
+        std::vector<std::set<vk::DeviceSize>> free_lists;
+        vk::DeviceSize used = 0;
+        vk::DeviceSize requested = 0;
+        uint32_t allocation_count = 0;
+    };
+
+    struct MemoryType {
+        vk::MemoryPropertyFlags properties;
+        vk::DeviceSize block_size;
+        uint32_t max_order;
+        // Released blocks leave an empty slot behind, so block indices in allocations stay valid
+        std::vector<Block> blocks;
+    };
+
+    const vk::PhysicalDevice physical_device_;
+    const vk::Device device_;
+    const vk::AllocationCallbacks* const allocation_callbacks_;
+    const uint32_t max_device_memory_count_;
+    // Smallest buddy size. Buddies are aligned to their size, so this being at least bufferImageGranularity keeps
+    // linear and optimal resources from sharing a page.
+    const vk::DeviceSize min_size_;
+    std::vector<MemoryType> memory_types_;
+    uint32_t device_memory_count_ = 0;
+    mutable std::mutex mutex_;
+
+    std::optional<Allocation> allocate_from_type(uint32_t memory_type_index, vk::DeviceSize size, vk::DeviceSize alignment);
+    std::optional<vk::DeviceSize> allocate_buddy(Block& block, uint32_t order);
+    uint32_t create_block(uint32_t memory_type_index, vk::DeviceSize size, bool dedicated);
+};
+
+#endif
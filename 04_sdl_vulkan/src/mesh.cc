@@ -0,0 +1,103 @@
+#include "mesh.hh"
+
+#include <algorithm>
+#include <array>
+
+#include "mesh_optimizer.hh"
+
+namespace {
+const std::array<Vertex, 3> TRIANGLE = {{
+        {{0.f, -.5f}, {1.f, 0.f, 0.f}},
+        {{.5f, .5f}, {0.f, 1.f, 0.f}},
+        {{-.5f, .5f}, {0.f, 0.f, 1.f}}
+}};
+
+// Converts the vertices with the bulk encoders, colors get an opaque alpha
+template <typename Position, typename Component>
+std::vector<std::byte> pack_vertices(const std::vector<Vertex>& vertices, void (*encode_positions)(const float*, size_t, Component*)) {
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec4> colors;
+    positions.reserve(vertices.size());
+    colors.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        positions.push_back(vertex.pos);
+        colors.emplace_back(vertex.color, 1.f);
+    }
+    std::vector<Position> encoded_positions(vertices.size());
+    std::vector<Unorm8x4> encoded_colors(vertices.size());
+    encode_positions(&positions[0].x, 2 * positions.size(), &encoded_positions[0].x);
+    encode_unorm8(&colors[0].x, 4 * colors.size(), &encoded_colors[0].x);
+
+    std::vector<std::byte> result(vertices.size() * sizeof(PackedVertex<Position>));
+    const auto packed = reinterpret_cast<PackedVertex<Position>*>(result.data());
+    for (size_t i = 0; i < vertices.size(); i++)
+        packed[i] = {encoded_positions[i], encoded_colors[i]};
+    return result;
+}
+}
+
+const VertexLayout<2>& get_vertex_layout(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::half:
+        return HALF_VERTEX_LAYOUT;
+    case VertexFormat::snorm16:
+        return SNORM16_VERTEX_LAYOUT;
+    default:
+        return VERTEX_LAYOUT;
+    }
+}
+
+// Row i from the first corner has i + 1 vertices
+Mesh generate_mesh(uint32_t subdivisions) {
+    Mesh mesh;
+    const auto n = static_cast<float>(subdivisions);
+    for (uint32_t i = 0; i <= subdivisions; i++) {
+        for (uint32_t j = 0; j <= i; j++) {
+            const float w1 = j / n, w2 = (i - j) / n, w0 = 1.f - w1 - w2;
+            mesh.vertices.push_back({w0 * TRIANGLE[0].pos + w1 * TRIANGLE[1].pos + w2 * TRIANGLE[2].pos,
+                    w0 * TRIANGLE[0].color + w1 * TRIANGLE[1].color + w2 * TRIANGLE[2].color});
+        }
+    }
+    const auto index = [](uint32_t i, uint32_t j) { return static_cast<uint16_t>(i * (i + 1) / 2 + j); };
+    for (uint32_t i = 0; i < subdivisions; i++) {
+        for (uint32_t j = 0; j <= i; j++) {
+            mesh.indices.insert(mesh.indices.end(), {index(i, j), index(i + 1, j + 1), index(i + 1, j)});
+            if (j < i)
+                mesh.indices.insert(mesh.indices.end(), {index(i, j), index(i, j + 1), index(i + 1, j + 1)});
+        }
+    }
+    return mesh;
+}
+
+float compute_radius(const std::vector<Vertex>& vertices) {
+    float radius = 0;
+    for (const auto& vertex : vertices)
+        radius = std::max(radius, glm::length(vertex.pos));
+    return radius;
+}
+
+void optimize_mesh(Mesh& mesh) {
+    auto indices = mesh.indices;
+    optimize_vertex_cache(indices, mesh.vertices.size());
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.vertices.size());
+    for (const auto& vertex : mesh.vertices)
+        positions.emplace_back(vertex.pos, 0.f);
+    optimize_overdraw(indices, positions);
+    if (analyze_vertex_cache(indices, mesh.vertices.size()).acmr < analyze_vertex_cache(mesh.indices, mesh.vertices.size()).acmr)
+        mesh.indices = std::move(indices);
+    optimize_vertex_fetch(mesh.indices, mesh.vertices);
+}
+
+std::vector<std::byte> encode_vertices(const std::vector<Vertex>& vertices, VertexFormat format) {
+    switch (format) {
+    case VertexFormat::half:
+        return pack_vertices<Half2, uint16_t>(vertices, encode_half);
+    case VertexFormat::snorm16:
+        return pack_vertices<Snorm16x2, int16_t>(vertices, encode_snorm16);
+    case VertexFormat::float32:
+        break;
+    }
+    const auto bytes = reinterpret_cast<const std::byte*>(vertices.data());
+    return std::vector<std::byte>(bytes, bytes + vertices.size() * sizeof(Vertex));
+}
@@ -0,0 +1,59 @@
+#ifndef MESH_HH_
+#define MESH_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "options.hh"
+#include "vertex_layout.hh"
+#include "vertex_packing.hh"
+
+struct Vertex {
+    glm::vec2 pos;
+    glm::vec3 color;
+};
+
+// Checked against shader.vert's inputs when the pipeline is requested
+inline constexpr auto VERTEX_LAYOUT = make_vertex_layout<Vertex>(0, vk::VertexInputRate::eVertex, {
+        VERTEX_FIELD(Vertex, pos, 0),
+        VERTEX_FIELD(Vertex, color, 1),
+});
+
+// Vertex with compact positions and 8-bit colors, 8 bytes instead of 20
+template <typename Position>
+struct PackedVertex {
+    Position pos;
+    Unorm8x4 color;
+};
+
+inline constexpr auto HALF_VERTEX_LAYOUT = make_vertex_layout<PackedVertex<Half2>>(0, vk::VertexInputRate::eVertex, {
+        VERTEX_FIELD(PackedVertex<Half2>, pos, 0),
+        VERTEX_FIELD(PackedVertex<Half2>, color, 1),
+});
+
+inline constexpr auto SNORM16_VERTEX_LAYOUT = make_vertex_layout<PackedVertex<Snorm16x2>>(0, vk::VertexInputRate::eVertex, {
+        VERTEX_FIELD(PackedVertex<Snorm16x2>, pos, 0),
+        VERTEX_FIELD(PackedVertex<Snorm16x2>, color, 1),
+});
+
+const VertexLayout<2>& get_vertex_layout(VertexFormat format);
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint16_t> indices;
+};
+
+// Splits the demo triangle into subdivisions² triangles with the same winding
+Mesh generate_mesh(uint32_t subdivisions);
+// Distance of the farthest vertex from the origin
+float compute_radius(const std::vector<Vertex>& vertices);
+// Vertex cache, overdraw and vertex fetch optimizations, in that order. The triangle order is kept if it simulates better
+// already, as small regular meshes may.
+void optimize_mesh(Mesh& mesh);
+// Vertex buffer contents in the given format
+std::vector<std::byte> encode_vertices(const std::vector<Vertex>& vertices, VertexFormat format);
+
+#endif
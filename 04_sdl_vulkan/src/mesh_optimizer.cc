@@ -0,0 +1,217 @@
+#include "mesh_optimizer.hh"
+
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+// FIFO cache simulation: a vertex is cached if it was among the last cache_size ones inserted, hits don't refresh it
+class VertexCache {
+public:
+    VertexCache(size_t vertex_count, uint32_t cache_size) : cache_size_(cache_size), timestamps_(vertex_count, 0), timestamp_(cache_size + 1) {}
+
+    // Returns whether the vertex missed
+    bool access(uint16_t vertex) {
+        if (timestamp_ - timestamps_[vertex] <= cache_size_)
+            return false;
+        timestamps_[vertex] = timestamp_++;
+        return true;
+    }
+
+    uint32_t access_triangle(const uint16_t* triangle) {
+        return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+    }
+
+    // Insertions since the vertex was inserted, above the cache size if it isn't cached
+    [[nodiscard]] uint32_t age(uint16_t vertex) const { return timestamp_ - timestamps_[vertex]; }
+
+    void clear() { timestamp_ += cache_size_ + 1; }
+
+private:
+    const uint32_t cache_size_;
+    std::vector<uint32_t> timestamps_;
+    uint32_t timestamp_;
+};
+
+// The passes index per vertex arrays with the indices
+void check_indices(std::span<const uint16_t> indices, size_t vertex_count) {
+    if (!indices_in_range(indices, vertex_count))
+        throw std::invalid_argument("Index out of the vertex range");
+}
+}
+
+bool indices_in_range(std::span<const uint16_t> indices, size_t vertex_count) {
+    return std::all_of(indices.begin(), indices.end(), [vertex_count](uint16_t index) { return index < vertex_count; });
+}
+
+VertexCacheStatistics analyze_vertex_cache(std::span<const uint16_t> indices, size_t vertex_count, uint32_t cache_size) {
+    check_indices(indices, vertex_count);
+    VertexCache cache(vertex_count, cache_size);
+    size_t misses = 0;
+    for (const auto index : indices)
+        misses += cache.access(index);
+    VertexCacheStatistics statistics;
+    if (indices.size() >= 3)
+        statistics.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    if (vertex_count)
+        statistics.atvr = static_cast<float>(misses) / static_cast<float>(vertex_count);
+    return statistics;
+}
+
+void optimize_vertex_cache(std::vector<uint16_t>& indices, size_t vertex_count, uint32_t cache_size) {
+    check_indices(indices, vertex_count);
+    const auto triangle_count = indices.size() / 3;
+    // Triangles using each vertex, those of vertex v at [offsets[v], offsets[v + 1])
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (const auto index : indices)
+        offsets[index + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+    // Triangles not emitted yet using each vertex
+    std::vector<uint32_t> live_counts(vertex_count);
+    for (size_t vertex = 0; vertex < vertex_count; vertex++)
+        live_counts[vertex] = offsets[vertex + 1] - offsets[vertex];
+
+    VertexCache cache(vertex_count, cache_size);
+    std::vector<bool> emitted(triangle_count, false);
+    // Recently emitted vertices, the next fanning vertex is looked for there when no candidate is left
+    std::vector<uint16_t> dead_ends;
+    std::vector<uint16_t> candidates;
+    std::vector<uint16_t> result;
+    result.reserve(triangle_count * 3);
+    size_t cursor = 0;
+    // Emits every remaining triangle around the fanning vertex, then moves to the candidate that is the oldest in the
+    // cache while staying cached once its own triangles are emitted
+    for (int64_t fanning = vertex_count ? 0 : -1; fanning >= 0;) {
+        candidates.clear();
+        for (auto i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+            const auto triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (size_t corner = 0; corner < 3; corner++) {
+                const auto vertex = indices[3 * triangle + corner];
+                result.push_back(vertex);
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                live_counts[vertex]--;
+                cache.access(vertex);
+            }
+        }
+        int64_t next = -1;
+        int64_t best_priority = -1;
+        for (const auto vertex : candidates) {
+            if (!live_counts[vertex])
+                continue;
+            const auto age = cache.age(vertex);
+            const int64_t priority = age + 2 * live_counts[vertex] <= cache_size ? age : 0;
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = vertex;
+            }
+        }
+        while (next < 0 && !dead_ends.empty()) {
+            if (live_counts[dead_ends.back()])
+                next = dead_ends.back();
+            dead_ends.pop_back();
+        }
+        for (; next < 0 && cursor < vertex_count; cursor++) {
+            if (live_counts[cursor])
+                next = cursor;
+        }
+        fanning = next;
+    }
+    indices = std::move(result);
+}
+
+void optimize_overdraw(std::vector<uint16_t>& indices, const std::vector<glm::vec3>& positions, float threshold, uint32_t cache_size) {
+    check_indices(indices, positions.size());
+    const auto triangle_count = indices.size() / 3;
+    if (!triangle_count)
+        return;
+    VertexCache cache(positions.size(), cache_size);
+    // Hard boundaries, where triangles share no vertex with the cache and the order starts over anyway
+    std::vector<size_t> hard_boundaries;
+    for (size_t triangle = 0; triangle < triangle_count; triangle++) {
+        if (cache.access_triangle(&indices[3 * triangle]) == 3 || !triangle)
+            hard_boundaries.push_back(triangle);
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Soft boundaries, wherever the part of a cluster since the previous one reached its cache miss ratio within threshold
+    std::vector<size_t> clusters;
+    for (size_t hard = 0; hard + 1 < hard_boundaries.size(); hard++) {
+        const auto start = hard_boundaries[hard], end = hard_boundaries[hard + 1];
+        cache.clear();
+        size_t cluster_misses = 0;
+        for (auto triangle = start; triangle < end; triangle++)
+            cluster_misses += cache.access_triangle(&indices[3 * triangle]);
+        const auto target = threshold * static_cast<float>(cluster_misses) / static_cast<float>(end - start);
+
+        const auto first_cluster = clusters.size();
+        clusters.push_back(start);
+        cache.clear();
+        size_t misses = 0, triangles = 0;
+        for (auto triangle = start; triangle < end; triangle++) {
+            misses += cache.access_triangle(&indices[3 * triangle]);
+            triangles++;
+            if (static_cast<float>(misses) <= target * static_cast<float>(triangles)) {
+                clusters.push_back(triangle + 1);
+                cache.clear();
+                misses = triangles = 0;
+            }
+        }
+        // What follows the last split didn't reach the target, it stays with the previous part
+        if (clusters.size() > first_cluster + 1)
+            clusters.pop_back();
+    }
+    const auto cluster_count = clusters.size();
+    clusters.push_back(triangle_count);
+
+    glm::vec3 mesh_center(0.f);
+    for (const auto index : indices)
+        mesh_center += positions[index];
+    mesh_center /= static_cast<float>(indices.size());
+    // Distance of each cluster from the center along its average normal
+    std::vector<float> keys(cluster_count, 0.f);
+    for (size_t cluster = 0; cluster < cluster_count; cluster++) {
+        glm::vec3 center(0.f), normal(0.f);
+        float area = 0;
+        for (auto triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++) {
+            const auto& p0 = positions[indices[3 * triangle]];
+            const auto& p1 = positions[indices[3 * triangle + 1]];
+            const auto& p2 = positions[indices[3 * triangle + 2]];
+            const auto triangle_normal = glm::cross(p1 - p0, p2 - p0);
+            const auto triangle_area = glm::length(triangle_normal);
+            center += (p0 + p1 + p2) * (triangle_area / 3.f);
+            normal += triangle_normal;
+            area += triangle_area;
+        }
+        const auto normal_length = glm::length(normal);
+        if (area > 0 && normal_length > 0)
+            keys[cluster] = glm::dot(center / area - mesh_center, normal / normal_length);
+    }
+    std::vector<size_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint16_t> result;
+    result.reserve(indices.size());
+    for (const auto cluster : order)
+        result.insert(result.end(), indices.begin() + 3 * clusters[cluster], indices.begin() + 3 * clusters[cluster + 1]);
+    indices = std::move(result);
+}
+
+std::vector<uint32_t> build_vertex_fetch_remap(std::vector<uint16_t>& indices, size_t vertex_count) {
+    check_indices(indices, vertex_count);
+    std::vector<uint32_t> remap(vertex_count, UNUSED_VERTEX);
+    uint32_t next = 0;
+    for (auto& index : indices) {
+        if (remap[index] == UNUSED_VERTEX)
+            remap[index] = next++;
+        index = static_cast<uint16_t>(remap[index]);
+    }
+    return remap;
+}
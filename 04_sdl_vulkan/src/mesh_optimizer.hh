@@ -0,0 +1,57 @@
+#ifndef MESH_OPTIMIZER_HH_
+#define MESH_OPTIMIZER_HH_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Post-transform cache size the optimizations target and the statistics simulate, a FIFO of vertices. Real GPUs differ,
+// but orders good for 16 entries are good for others.
+const uint32_t VERTEX_CACHE_SIZE = 16;
+// Returned by build_vertex_fetch_remap for vertices no triangle uses
+const uint32_t UNUSED_VERTEX = UINT32_MAX;
+
+struct VertexCacheStatistics {
+    // Average cache miss ratio, vertex shader invocations per triangle: 3 without reuse, 0.5 at best on large meshes
+    float acmr = 0;
+    // Average transform to vertex ratio, invocations per vertex: 1 at best
+    float atvr = 0;
+};
+
+// Whether every index refers to one of vertex_count vertices. The functions below throw std::invalid_argument otherwise.
+bool indices_in_range(std::span<const uint16_t> indices, size_t vertex_count);
+
+// Simulates the vertex cache over the triangle list
+VertexCacheStatistics analyze_vertex_cache(std::span<const uint16_t> indices, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders triangles so consecutive ones reuse cached vertices, with Tipsify from Sander et al., "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw". Linear in the triangle count.
+void optimize_vertex_cache(std::vector<uint16_t>& indices, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders clusters of triangles of a cache optimized list, so those facing away from the mesh center, likely to occlude
+// the others, are drawn first. Clusters are split wherever their cache miss ratio stays within threshold times the one
+// of the unsplit cluster, so vertex cache efficiency degrades by at most that factor. Outward normals are taken from
+// counter-clockwise winding. Flat meshes don't change.
+void optimize_overdraw(std::vector<uint16_t>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f, uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// New index of each vertex, so vertices are stored in the order triangles first use them, and rewrites indices with them
+std::vector<uint32_t> build_vertex_fetch_remap(std::vector<uint16_t>& indices, size_t vertex_count);
+
+// Reorders vertices in the order of their first use so fetches are sequential, dropping unused ones
+template <typename Vertex>
+void optimize_vertex_fetch(std::vector<uint16_t>& indices, std::vector<Vertex>& vertices) {
+    const auto remap = build_vertex_fetch_remap(indices, vertices.size());
+    std::vector<Vertex> result(std::count_if(remap.begin(), remap.end(), [](uint32_t index) { return index != UNUSED_VERTEX; }));
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] != UNUSED_VERTEX)
+            result[remap[i]] = vertices[i];
+    }
+    vertices = std::move(result);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#include "offscreen_target.hh"
+
+OffscreenTarget::OffscreenTarget(MemoryAllocator& memory_allocator, vk::Extent2D extent, uint32_t image_count, const vk::AllocationCallbacks* view_allocation_callbacks) :
+    memory_allocator_(memory_allocator), extent_(extent), image_count_(image_count), view_allocation_callbacks_(view_allocation_callbacks) {}
+
+void OffscreenTarget::recreate() {
+    image_views_.clear();
+    images_.clear();
+    for (uint32_t i = 0; i < image_count_; i++) {
+        const vk::ImageCreateInfo image_create_info({}, vk::ImageType::e2D, format(), vk::Extent3D(extent_.width, extent_.height, 1), 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::eUndefined);
+        auto image = memory_allocator_.create_image(image_create_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        const vk::ImageViewCreateInfo view_create_info({}, *image.image, vk::ImageViewType::e2D, format(), vk::ComponentMapping(),
+                vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        image_views_.push_back(memory_allocator_.get_device().createImageViewUnique(view_create_info, view_allocation_callbacks_));
+        images_.push_back(std::move(image));
+    }
+    next_image_ = 0;
+}
+
+std::optional<uint32_t> OffscreenTarget::acquire(vk::Semaphore) {
+    const auto image_index = next_image_;
+    next_image_ = (next_image_ + 1) % image_count_;
+    return image_index;
+}
+
+bool OffscreenTarget::present(uint32_t, vk::Semaphore) {
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef OFFSCREEN_TARGET_HH_
+#define OFFSCREEN_TARGET_HH_
+
+#include "memory_allocator.hh"
+#include "render_target.hh"
+
+// Renders into device local images that are never presented, for running without a window
+class OffscreenTarget : public RenderTarget {
+public:
+    // Image views are created with view_allocation_callbacks, which may be null
+    OffscreenTarget(MemoryAllocator& memory_allocator, vk::Extent2D extent, uint32_t image_count, const vk::AllocationCallbacks* view_allocation_callbacks);
+
+    void recreate() override;
+    [[nodiscard]] vk::Format format() const override { return vk::Format::eR8G8B8A8Unorm; }
+    [[nodiscard]] vk::Extent2D extent() const override { return extent_; }
+    [[nodiscard]] vk::ImageLayout final_layout() const override { return vk::ImageLayout::eTransferSrcOptimal; }
+    [[nodiscard]] const std::vector<vk::UniqueImageView>& image_views() const override { return image_views_; }
+    [[nodiscard]] bool uses_semaphores() const override { return false; }
+    std::optional<uint32_t> acquire(vk::Semaphore image_available) override;
+    bool present(uint32_t image_index, vk::Semaphore render_finished) override;
+
+private:
+    MemoryAllocator& memory_allocator_;
+    const vk::Extent2D extent_;
+    const uint32_t image_count_;
+    const vk::AllocationCallbacks* const view_allocation_callbacks_;
+    std::vector<Image> images_;
+    std::vector<vk::UniqueImageView> image_views_;
+    uint32_t next_image_ = 0;
+};
+
+#endif
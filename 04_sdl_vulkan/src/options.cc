@@ -0,0 +1,208 @@
+#include "options.hh"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace {
+uint32_t parse_uint(std::string_view option, std::string_view value, uint32_t min, uint32_t max) {
+    uint32_t result;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error != std::errc() || end != value.data() + value.size() || result < min || result > max)
+        throw options_error(std::string(option) + ": expected an integer in [" + std::to_string(min) + ", " + std::to_string(max) + "], got \"" + std::string(value) + "\"");
+    return result;
+}
+
+float parse_float(std::string_view option, std::string_view value, float min, float max) {
+    const std::string string(value);
+    char* end;
+    const auto result = std::strtof(string.c_str(), &end);
+    if (string.empty() || *end || !std::isfinite(result) || result < min || result > max)
+        throw options_error(std::string(option) + ": expected a number in [" + std::to_string(min) + ", " + std::to_string(max) + "], got \"" + string + "\"");
+    return result;
+}
+
+DrawMode parse_draw_mode(std::string_view option, std::string_view value) {
+    if (value == "instanced")
+        return DrawMode::instanced;
+    if (value == "direct")
+        return DrawMode::direct;
+    if (value == "indirect")
+        return DrawMode::indirect;
+    throw options_error(std::string(option) + ": expected instanced, direct or indirect, got \"" + std::string(value) + "\"");
+}
+
+LoopMode parse_loop_mode(std::string_view option, std::string_view value) {
+    if (value == "wait")
+        return LoopMode::wait;
+    if (value == "continuous")
+        return LoopMode::continuous;
+    if (value == "on-demand")
+        return LoopMode::on_demand;
+    throw options_error(std::string(option) + ": expected wait, continuous or on-demand, got \"" + std::string(value) + "\"");
+}
+
+PresentPolicy parse_present_policy(std::string_view option, std::string_view value) {
+    if (value == "low-latency")
+        return PresentPolicy::low_latency;
+    if (value == "vsync")
+        return PresentPolicy::vsync;
+    if (value == "relaxed")
+        return PresentPolicy::relaxed;
+    throw options_error(std::string(option) + ": expected low-latency, vsync or relaxed, got \"" + std::string(value) + "\"");
+}
+
+Shading parse_shading(std::string_view option, std::string_view value) {
+    if (value == "vertex")
+        return Shading::vertex_colors;
+    if (value == "flat")
+        return Shading::flat;
+    if (value == "grayscale")
+        return Shading::grayscale;
+    throw options_error(std::string(option) + ": expected vertex, flat or grayscale, got \"" + std::string(value) + "\"");
+}
+
+VertexFormat parse_vertex_format(std::string_view option, std::string_view value) {
+    if (value == "float")
+        return VertexFormat::float32;
+    if (value == "half")
+        return VertexFormat::half;
+    if (value == "snorm16")
+        return VertexFormat::snorm16;
+    throw options_error(std::string(option) + ": expected float, half or snorm16, got \"" + std::string(value) + "\"");
+}
+
+vk::Extent2D parse_extent(std::string_view option, std::string_view value) {
+    const auto separator = value.find('x');
+    if (separator == std::string_view::npos)
+        throw options_error(std::string(option) + ": expected WIDTHxHEIGHT, got \"" + std::string(value) + "\"");
+    return {parse_uint(option, value.substr(0, separator), 1, 16384), parse_uint(option, value.substr(separator + 1), 1, 16384)};
+}
+}
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    bool loop_given = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view option = argv[i];
+        const auto value = [&]() -> std::string_view {
+            if (i + 1 >= argc)
+                throw options_error(std::string(option) + ": missing value");
+            return argv[++i];
+        };
+
+        if (option == "--frames-in-flight") {
+            options.frames_in_flight = parse_uint(option, value(), 1, 3);
+        } else if (option == "--loop") {
+            options.loop_mode = parse_loop_mode(option, value());
+            loop_given = true;
+        } else if (option == "--render-thread") {
+            options.render_thread = true;
+        } else if (option == "--fps-limit") {
+            options.fps_limit = parse_uint(option, value(), 1, 10000);
+        } else if (option == "--benchmark-frames") {
+            options.benchmark_frames = parse_uint(option, value(), 1, UINT32_MAX);
+        } else if (option == "--assert-zero-alloc") {
+            options.assert_zero_allocations = true;
+        } else if (option == "--profile") {
+            options.profile = true;
+        } else if (option == "--profile-csv") {
+            options.profile = true;
+            options.profile_csv_path = value();
+        } else if (option == "--profile-json") {
+            options.profile = true;
+            options.profile_json_path = value();
+        } else if (option == "--log-file") {
+            options.log_file_path = value();
+        } else if (option == "--pipeline-cache") {
+            options.pipeline_cache_path = value();
+        } else if (option == "--no-pipeline-cache") {
+            options.pipeline_cache_path.clear();
+        } else if (option == "--pipeline-threads") {
+            options.pipeline_threads = parse_uint(option, value(), 1, 16);
+        } else if (option == "--instances") {
+            options.instance_count = parse_uint(option, value(), 1, 1 << 24);
+        } else if (option == "--draw-mode") {
+            options.draw_mode = parse_draw_mode(option, value());
+        } else if (option == "--shading") {
+            options.shading = parse_shading(option, value());
+        } else if (option == "--vertex-format") {
+            options.vertex_format = parse_vertex_format(option, value());
+        } else if (option == "--mesh-subdivisions") {
+            options.mesh_subdivisions = parse_uint(option, value(), 1, MAX_MESH_SUBDIVISIONS);
+        } else if (option == "--optimize-mesh") {
+            options.optimize_mesh = true;
+        } else if (option == "--asset-pack") {
+            options.asset_pack_path = value();
+        } else if (option == "--record-every-frame") {
+            options.record_every_frame = true;
+        } else if (option == "--record-threads") {
+            options.record_threads = parse_uint(option, value(), 1, MAX_RECORD_THREADS);
+        } else if (option == "--scene-scale") {
+            options.scene_scale = parse_float(option, value(), 1, 1000);
+        } else if (option == "--rotation-speed") {
+            options.rotation_speed = parse_float(option, value(), -100, 100);
+        } else if (option == "--present") {
+            options.present_policy = parse_present_policy(option, value());
+        } else if (option == "--swapchain-images") {
+            options.swapchain_images = parse_uint(option, value(), 1, 16);
+        } else if (option == "--upload-benchmark") {
+            options.upload_benchmark_mib = parse_uint(option, value(), 1, 1 << 20);
+        } else if (option == "--headless") {
+            options.headless = true;
+        } else if (option == "--size") {
+            options.headless_extent = parse_extent(option, value());
+        } else {
+            throw options_error("Unknown option \"" + std::string(option) + "\"");
+        }
+    }
+    // A frame rate limit only makes sense when rendering without waiting for events, whatever the order of the options
+    if (options.fps_limit && !loop_given)
+        options.loop_mode = LoopMode::continuous;
+    // The render thread doesn't receive input events, which the redraw scheduler throttles on
+    if (options.render_thread && options.loop_mode == LoopMode::on_demand)
+        throw options_error("--render-thread: not supported with --loop on-demand");
+    if (options.assert_zero_allocations && options.benchmark_frames <= ZERO_ALLOCATION_WARMUP_FRAMES)
+        throw options_error("--assert-zero-alloc: needs --benchmark-frames above " + std::to_string(ZERO_ALLOCATION_WARMUP_FRAMES));
+    return options;
+}
+
+void print_usage(std::ostream& stream) {
+    stream << "Usage: main [options]\n"
+              "  --frames-in-flight N   frames recorded ahead of the GPU, 1 to 3 (default 2)\n"
+              "  --loop MODE            wait (render after window events, default), continuous (render without blocking on events) or\n"
+              "                         on-demand (render only what was invalidated, throttled while there is no input)\n"
+              "  --render-thread        render on a separate thread, so stalls in window event handling don't delay frames, except with\n"
+              "                         --loop on-demand\n"
+              "  --fps-limit N          render at most N frames/s, continuously unless --loop is given\n"
+              "  --benchmark-frames N   render N frames without waiting for events, report frames/s and exit\n"
+              "  --assert-zero-alloc    with --benchmark-frames, fail if a frame allocates heap memory after the warm-up frames\n"
+              "  --profile              record CPU phase and GPU render pass timings, print p50/p99 at exit\n"
+              "  --profile-csv FILE     write the frame timings to FILE as CSV at exit (implies --profile)\n"
+              "  --profile-json FILE    write the frame timings to FILE as JSON at exit (implies --profile)\n"
+              "  --log-file FILE        write log messages to FILE instead of SDL_Log\n"
+              "  --pipeline-cache FILE  load the pipeline cache from FILE at startup and save it at exit (default pipeline_cache.bin)\n"
+              "  --no-pipeline-cache    do not load or save a pipeline cache\n"
+              "  --pipeline-threads N   compile pipelines on N background threads (default 1)\n"
+              "  --instances N          draw N instances of the triangle in a single draw call (default 1)\n"
+              "  --draw-mode MODE       instanced (one draw call), direct (one draw call per instance recorded by the CPU) or\n"
+              "                         indirect (GPU frustum culling writing one indirect draw per visible instance)\n"
+              "  --shading MODE         vertex (vertex colors tinted per instance, default), flat (instance colors) or grayscale,\n"
+              "                         a specialization constant of the fragment shader\n"
+              "  --vertex-format FORMAT float (32-bit float positions and colors, default), half (half float positions) or\n"
+              "                         snorm16 (16-bit normalized positions), both with 8-bit colors\n"
+              "  --mesh-subdivisions N  split the triangle into N² triangles, at most 360 (default 1)\n"
+              "  --optimize-mesh        reorder the mesh's triangles and vertices for the vertex cache, overdraw and fetches\n"
+              "  --asset-pack FILE      load the mesh and shaders from FILE, written by asset_packer, instead of generating them\n"
+              "  --record-every-frame   record the command buffer of every frame instead of reusing prerecorded ones\n"
+              "  --record-threads N     record the draw calls of each frame on N threads into secondary command buffers (default 1)\n"
+              "  --scene-scale S        spread the instances over S times the viewport, so only some of them are visible (default 1)\n"
+              "  --rotation-speed R     rotate the instances at R radians per second, animated through per-frame uniforms (default 0)\n"
+              "  --present POLICY       low-latency (mailbox, else immediate), vsync (FIFO, default) or relaxed (FIFO relaxed)\n"
+              "  --swapchain-images N   number of swapchain images (default: one more than the surface's minimum)\n"
+              "  --upload-benchmark MIB upload MIB MiB through the staging ring, report the bandwidth and exit\n"
+              "  --headless             render into offscreen images, without a window or presentation support\n"
+              "  --size WIDTHxHEIGHT    size of the offscreen images in headless mode (default 800x600)\n";
+}
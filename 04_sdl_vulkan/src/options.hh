@@ -0,0 +1,125 @@
+#ifndef OPTIONS_HH_
+#define OPTIONS_HH_
+
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+
+class options_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+enum class DrawMode {
+    // One instanced draw call for all objects
+    instanced,
+    // One draw call per object, recorded by the CPU
+    direct,
+    // Objects are frustum culled by a compute pass which writes one indirect draw command per visible object
+    indirect,
+};
+
+enum class LoopMode {
+    // Block until a window event arrives before rendering
+    wait,
+    // Render continuously, polling events without blocking
+    continuous,
+    // Only render when the window or the render target needs it, at a rate lowered while there is no input
+    on_demand,
+};
+
+// Present modes are chosen among the ones the surface supports, FIFO being the fallback
+enum class PresentPolicy {
+    // Mailbox, else immediate: frames are shown as soon as possible, immediate may tear
+    low_latency,
+    // FIFO: one frame per vertical blank, no tearing
+    vsync,
+    // FIFO relaxed: like vsync, but late frames are shown immediately and may tear
+    relaxed,
+};
+
+// Values of shader.frag's SHADING specialization constant
+enum class Shading : uint32_t {
+    // Vertex colors tinted by the instance color
+    vertex_colors,
+    // Instance color only
+    flat,
+    // Luminance of the tinted vertex colors
+    grayscale,
+};
+
+// Encoding of the mesh vertices, colors are 8-bit unorm in the packed formats
+enum class VertexFormat {
+    // 32-bit float positions and colors, 20 bytes per vertex
+    float32,
+    // Half float positions, 8 bytes per vertex
+    half,
+    // 16-bit snorm positions, which must be within [-1, 1], 8 bytes per vertex
+    snorm16,
+};
+
+const uint32_t MAX_RECORD_THREADS = 64;
+// Keeps the subdivided mesh's vertex count within 16-bit indices
+const uint32_t MAX_MESH_SUBDIVISIONS = 360;
+// Frames rendered before allocations are counted, enough for every frame slot and target image to have been used
+const uint32_t ZERO_ALLOCATION_WARMUP_FRAMES = 64;
+
+struct Options {
+    // Number of frames the CPU may record and submit before waiting for the GPU
+    uint32_t frames_in_flight = 2;
+    LoopMode loop_mode = LoopMode::wait;
+    // Render on a separate thread, fed with window events by the main thread
+    bool render_thread = false;
+    // If non-zero, the continuous loop is limited to this frame rate
+    uint32_t fps_limit = 0;
+    // If non-zero, render this many frames as fast as possible, report the frame rate and exit
+    uint32_t benchmark_frames = 0;
+    // Fail the frame benchmark if a frame after the warm-up allocates heap memory
+    bool assert_zero_allocations = false;
+    // If non-zero, measure the upload bandwidth by uploading this many MiB and exit
+    uint32_t upload_benchmark_mib = 0;
+    // Number of triangles drawn with a single instanced draw call
+    uint32_t instance_count = 1;
+    DrawMode draw_mode = DrawMode::instanced;
+    Shading shading = Shading::vertex_colors;
+    VertexFormat vertex_format = VertexFormat::float32;
+    // The triangle is split into subdivisions² triangles, for scenes where vertex fetch matters
+    uint32_t mesh_subdivisions = 1;
+    // Reorder the generated mesh for the vertex cache, overdraw and vertex fetches before uploading it
+    bool optimize_mesh = false;
+    // If not empty, the mesh and shaders are loaded from this asset pack, whose vertex format replaces vertex_format
+    std::string asset_pack_path;
+    // Record the command buffer of each frame right before submitting it, instead of once per target image
+    bool record_every_frame = false;
+    // Threads recording the draw calls into secondary command buffers, one records inline into the primary command buffers
+    uint32_t record_threads = 1;
+    // Instances are spread over [-scene_scale, scene_scale], values above 1 place some of them out of view
+    float scene_scale = 1;
+    // Radians per second the instances rotate at, even ones counterclockwise and odd ones clockwise, through the frame uniforms
+    float rotation_speed = 0;
+    PresentPolicy present_policy = PresentPolicy::vsync;
+    // Number of swapchain images, clamped to what the surface supports. If 0, one more than the surface's minimum.
+    uint32_t swapchain_images = 0;
+    // Render into offscreen images without creating a window
+    bool headless = false;
+    vk::Extent2D headless_extent = {800, 600};
+    // Record CPU and GPU frame timings and print a summary at exit
+    bool profile = false;
+    // If not empty, the recorded frame timings are written to these files at exit
+    std::string profile_csv_path;
+    std::string profile_json_path;
+    // If not empty, log messages are written to this file instead of SDL_Log
+    std::string log_file_path;
+    // Threads compiling pipelines in the background
+    uint32_t pipeline_threads = 1;
+    // Pipeline cache file loaded at startup and saved at exit, disabled if empty
+    std::string pipeline_cache_path = "pipeline_cache.bin";
+};
+
+Options parse_options(int argc, char **argv);
+void print_usage(std::ostream& stream);
+
+#endif
@@ -0,0 +1,74 @@
+#include "pipeline_cache.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "log.hh"
+
+namespace {
+const char MAGIC[4] = {'H', 'V', 'P', 'C'};
+const uint32_t FILE_VERSION = 1;
+}
+
+PipelineCache::PipelineCache(vk::PhysicalDevice physical_device, vk::Device device, const vk::AllocationCallbacks* allocation_callbacks, std::string path) :
+    device_(device), path_(std::move(path)) {
+    const auto properties = physical_device.getProperties();
+    std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+    header_.version = FILE_VERSION;
+    header_.vendor_id = properties.vendorID;
+    header_.device_id = properties.deviceID;
+    header_.driver_version = properties.driverVersion;
+    std::memcpy(header_.pipeline_cache_uuid, &properties.pipelineCacheUUID[0], VK_UUID_SIZE);
+    header_.data_size = 0;
+
+    const auto data = load();
+    warm_ = !data.empty();
+    const vk::PipelineCacheCreateInfo create_info({}, data.size(), data.data());
+    cache_ = device_.createPipelineCacheUnique(create_info, allocation_callbacks);
+}
+
+std::vector<char> PipelineCache::load() const {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file)
+        return {};
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return {};
+    if (std::memcmp(header.magic, header_.magic, sizeof(header.magic)) || header.version != header_.version || header.vendor_id != header_.vendor_id
+            || header.device_id != header_.device_id || header.driver_version != header_.driver_version
+            || std::memcmp(header.pipeline_cache_uuid, header_.pipeline_cache_uuid, VK_UUID_SIZE)) {
+        log_warning("Ignoring pipeline cache ", path_, " written by another device or driver");
+        return {};
+    }
+    // The size comes from the file, so it is checked before allocating, a damaged header must not fail startup
+    std::error_code error;
+    const auto file_size = std::filesystem::file_size(path_, error);
+    if (error || file_size - sizeof(header) != header.data_size) {
+        log_warning("Ignoring pipeline cache ", path_, " whose size doesn't match its header");
+        return {};
+    }
+    std::vector<char> data(header.data_size);
+    if (!file.read(data.data(), data.size())) {
+        log_warning("Ignoring truncated pipeline cache ", path_);
+        return {};
+    }
+    return data;
+}
+
+void PipelineCache::save() const {
+    const auto data = device_.getPipelineCacheData(*cache_);
+    auto header = header_;
+    header.data_size = data.size();
+
+    // Write to a temporary file first so a crash never leaves a truncated cache behind
+    const auto temporary_path = path_ + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file)
+            throw std::runtime_error("Failed to write pipeline cache " + temporary_path);
+    }
+    std::filesystem::rename(temporary_path, path_);
+}
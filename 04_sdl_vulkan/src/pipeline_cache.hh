@@ -0,0 +1,39 @@
+#ifndef PIPELINE_CACHE_HH_
+#define PIPELINE_CACHE_HH_
+
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+
+// vk::PipelineCache persisted to a file. The file is only reused by the same device and driver version.
+class PipelineCache {
+public:
+    // Loads the cache from path if it is valid for the device, otherwise starts empty
+    PipelineCache(vk::PhysicalDevice physical_device, vk::Device device, const vk::AllocationCallbacks* allocation_callbacks, std::string path);
+    [[nodiscard]] vk::PipelineCache get() const { return *cache_; }
+    // Whether previously saved data was loaded
+    [[nodiscard]] bool is_warm() const { return warm_; }
+    void save() const;
+
+private:
+    // Prefixed to the cache data, the data also has a header but its layout depends on the Vulkan version
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+    };
+
+    const vk::Device device_;
+    const std::string path_;
+    FileHeader header_;
+    vk::UniquePipelineCache cache_;
+    bool warm_ = false;
+
+    [[nodiscard]] std::vector<char> load() const;
+};
+
+#endif
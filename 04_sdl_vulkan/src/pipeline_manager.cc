@@ -0,0 +1,181 @@
+#include "pipeline_manager.hh"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "log.hh"
+#include "spirv_reflection.hh"
+
+namespace {
+void hash_combine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+}
+
+bool PipelineKey::operator==(const PipelineKey& other) const {
+    return vertex_shader == other.vertex_shader && vertex_shader_size == other.vertex_shader_size && fragment_shader == other.fragment_shader
+            && fragment_shader_size == other.fragment_shader_size && vertex_specialization == other.vertex_specialization
+            && fragment_specialization == other.fragment_specialization && bindings == other.bindings && binding_count == other.binding_count
+            && attributes == other.attributes && attribute_count == other.attribute_count && topology == other.topology && polygon_mode == other.polygon_mode
+            && cull_mode == other.cull_mode && front_face == other.front_face && blend == other.blend && layout == other.layout && render_pass == other.render_pass;
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey& key) const {
+    size_t seed = 0;
+    hash_combine(seed, std::hash<const uint32_t*>()(key.vertex_shader));
+    hash_combine(seed, key.vertex_shader_size);
+    hash_combine(seed, std::hash<const uint32_t*>()(key.fragment_shader));
+    hash_combine(seed, key.fragment_shader_size);
+    hash_combine(seed, key.vertex_specialization.hash());
+    hash_combine(seed, key.fragment_specialization.hash());
+    for (uint32_t i = 0; i < key.binding_count; i++) {
+        const auto& binding = key.bindings[i];
+        hash_combine(seed, binding.binding);
+        hash_combine(seed, binding.stride);
+        hash_combine(seed, static_cast<uint64_t>(binding.inputRate));
+    }
+    for (uint32_t i = 0; i < key.attribute_count; i++) {
+        const auto& attribute = key.attributes[i];
+        hash_combine(seed, attribute.location);
+        hash_combine(seed, attribute.binding);
+        hash_combine(seed, static_cast<uint64_t>(attribute.format));
+        hash_combine(seed, attribute.offset);
+    }
+    hash_combine(seed, static_cast<uint64_t>(key.topology));
+    hash_combine(seed, static_cast<uint64_t>(key.polygon_mode));
+    hash_combine(seed, static_cast<VkCullModeFlags>(key.cull_mode));
+    hash_combine(seed, static_cast<uint64_t>(key.front_face));
+    hash_combine(seed, key.blend);
+    hash_combine(seed, std::hash<vk::PipelineLayout>()(key.layout));
+    hash_combine(seed, std::hash<vk::RenderPass>()(key.render_pass));
+    return seed;
+}
+
+PipelineManager::PipelineManager(vk::Device device, vk::PipelineCache pipeline_cache, const vk::AllocationCallbacks* allocation_callbacks, uint32_t thread_count) :
+    device_(device), pipeline_cache_(pipeline_cache), allocation_callbacks_(allocation_callbacks), entries_(std::make_unique<Entry[]>(CAPACITY)) {
+    for (uint32_t i = 0; i < thread_count; i++)
+        threads_.emplace_back(&PipelineManager::work, this);
+}
+
+PipelineManager::~PipelineManager() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    compile_pending_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+PipelineId PipelineManager::request(const PipelineKey& key, std::optional<PipelineId> fallback) {
+    PipelineId id;
+    {
+        std::lock_guard lock(mutex_);
+        if (const auto existing = ids_.find(key); existing != ids_.end())
+            return existing->second;
+        if (entry_count_ == CAPACITY)
+            throw std::runtime_error("Too many pipelines");
+        // Once per key, so mismatches are reported by the request instead of as undefined behavior when drawing
+        check_vertex_inputs(reflect_inputs(key.vertex_shader, key.vertex_shader_size), key.attributes.data(), key.attribute_count);
+        id = entry_count_++;
+        entries_[id].key = key;
+        entries_[id].fallback = fallback;
+        ids_.emplace(key, id);
+        queue_.push_back(id);
+    }
+    compile_pending_.notify_one();
+    return id;
+}
+
+vk::Pipeline PipelineManager::get(PipelineId id) const {
+    const auto& entry = entries_[id];
+    auto pipeline = entry.ready.load(std::memory_order_acquire);
+    if (!pipeline && entry.fallback)
+        pipeline = entries_[*entry.fallback].ready.load(std::memory_order_acquire);
+    return vk::Pipeline(pipeline);
+}
+
+void PipelineManager::wait_idle() {
+    std::unique_lock lock(mutex_);
+    compile_finished_.wait(lock, [this] { return queue_.empty() && !compiling_count_; });
+}
+
+void PipelineManager::clear() {
+    std::unique_lock lock(mutex_);
+    queue_.clear();
+    compile_finished_.wait(lock, [this] { return !compiling_count_; });
+    for (uint32_t i = 0; i < entry_count_; i++) {
+        entries_[i].ready.store(VK_NULL_HANDLE, std::memory_order_relaxed);
+        entries_[i].pipeline.reset();
+        entries_[i].fallback.reset();
+    }
+    entry_count_ = 0;
+    ids_.clear();
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+void PipelineManager::work() {
+    for (;;) {
+        PipelineId id;
+        {
+            std::unique_lock lock(mutex_);
+            compile_pending_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+                return;
+            id = queue_.front();
+            queue_.pop_front();
+            compiling_count_++;
+        }
+        auto& entry = entries_[id];
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            entry.pipeline = compile(entry.key);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            log_info("Pipeline ", id, " compiled in ", elapsed.count(), " ms");
+        } catch (const std::exception& e) {
+            log_error("Failed to compile pipeline ", id, ": ", e.what());
+        }
+        // Published before the generation changes, so a command buffer recorded after seeing the new generation uses it
+        if (entry.pipeline)
+            entry.ready.store(static_cast<VkPipeline>(*entry.pipeline), std::memory_order_release);
+        generation_.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard lock(mutex_);
+            compiling_count_--;
+        }
+        compile_finished_.notify_all();
+    }
+}
+
+vk::UniquePipeline PipelineManager::compile(const PipelineKey& key) const {
+    const auto vertex_shader = device_.createShaderModuleUnique(vk::ShaderModuleCreateInfo({}, key.vertex_shader_size, key.vertex_shader), allocation_callbacks_);
+    const auto fragment_shader = device_.createShaderModuleUnique(vk::ShaderModuleCreateInfo({}, key.fragment_shader_size, key.fragment_shader), allocation_callbacks_);
+    const auto vertex_specialization_info = key.vertex_specialization.info();
+    const auto fragment_specialization_info = key.fragment_specialization.info();
+    const std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, *vertex_shader, "main",
+                key.vertex_specialization.empty() ? nullptr : &vertex_specialization_info),
+        vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, *fragment_shader, "main",
+                key.fragment_specialization.empty() ? nullptr : &fragment_specialization_info),
+    };
+
+    const vk::PipelineVertexInputStateCreateInfo vertex_input_info({}, key.binding_count, key.bindings.data(), key.attribute_count, key.attributes.data());
+    const vk::PipelineInputAssemblyStateCreateInfo input_assembly({}, key.topology);
+    // Viewport and scissor are set when recording, so resizing doesn't require a new pipeline
+    const vk::PipelineViewportStateCreateInfo viewport_state({}, 1, nullptr, 1, nullptr);
+    const std::array<vk::DynamicState, 2> dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    const vk::PipelineDynamicStateCreateInfo dynamic_state({}, dynamic_states.size(), dynamic_states.data());
+    const vk::PipelineRasterizationStateCreateInfo rasterizer({}, false, false, key.polygon_mode, key.cull_mode, key.front_face, false, {}, {}, {}, 1.);
+    const vk::PipelineMultisampleStateCreateInfo multisampling({}, vk::SampleCountFlagBits::e1, false);
+    const vk::PipelineColorBlendAttachmentState color_blend_attachment(key.blend, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+            vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
+            vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+    const vk::PipelineColorBlendStateCreateInfo color_blend_create_info({}, {}, vk::LogicOp::eClear, 1, &color_blend_attachment);
+
+    const vk::GraphicsPipelineCreateInfo create_info({}, stages.size(), stages.data(), &vertex_input_info, &input_assembly, {}, &viewport_state, &rasterizer, &multisampling, {},
+            &color_blend_create_info, &dynamic_state, key.layout, key.render_pass);
+    auto pipeline_result_value = device_.createGraphicsPipelinesUnique(pipeline_cache_, create_info, allocation_callbacks_);
+    if (pipeline_result_value.result != vk::Result::eSuccess)
+        throw std::runtime_error("vkCreateGraphicsPipelines returned " + vk::to_string(pipeline_result_value.result));
+    return std::move(pipeline_result_value.value[0]);
+}
@@ -0,0 +1,109 @@
+#ifndef PIPELINE_MANAGER_HH_
+#define PIPELINE_MANAGER_HH_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "specialization.hh"
+
+const uint32_t MAX_VERTEX_BINDINGS = 4;
+const uint32_t MAX_VERTEX_ATTRIBUTES = 8;
+
+// Everything a graphics pipeline is built from. Viewport and scissor are always dynamic.
+struct PipelineKey {
+    // SPIR-V compiled into the executable, identified by address
+    const uint32_t* vertex_shader = nullptr;
+    size_t vertex_shader_size = 0;
+    const uint32_t* fragment_shader = nullptr;
+    size_t fragment_shader_size = 0;
+    // Variants of the same modules differ only by these
+    SpecializationConstants vertex_specialization;
+    SpecializationConstants fragment_specialization;
+    std::array<vk::VertexInputBindingDescription, MAX_VERTEX_BINDINGS> bindings{};
+    uint32_t binding_count = 0;
+    std::array<vk::VertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> attributes{};
+    uint32_t attribute_count = 0;
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace front_face = vk::FrontFace::eClockwise;
+    // Alpha blending over the destination if set, otherwise opaque
+    bool blend = false;
+    vk::PipelineLayout layout;
+    vk::RenderPass render_pass;
+
+    bool operator==(const PipelineKey& other) const;
+};
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey& key) const;
+};
+
+using PipelineId = uint32_t;
+
+// Compiles graphics pipelines on worker threads, so requesting a new one never blocks rendering. Identical keys share a
+// single pipeline. get() doesn't block or allocate and may be called from any thread.
+class PipelineManager {
+public:
+    // Pipelines are created through pipeline_cache, which may be null, and with allocation_callbacks, which may be null
+    PipelineManager(vk::Device device, vk::PipelineCache pipeline_cache, const vk::AllocationCallbacks* allocation_callbacks, uint32_t thread_count);
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+    ~PipelineManager();
+
+    // Queues the pipeline for compilation unless the key was already requested. Until it is ready, get() returns the
+    // fallback pipeline, which must be usable in the same render pass, or null if there is none.
+    PipelineId request(const PipelineKey& key, std::optional<PipelineId> fallback = std::nullopt);
+    // The pipeline, its fallback if it isn't ready, or null in which case draws using it should be skipped
+    [[nodiscard]] vk::Pipeline get(PipelineId id) const;
+    // Incremented whenever a pipeline becomes ready, prerecorded command buffers using an older generation may be outdated
+    [[nodiscard]] uint32_t get_generation() const { return generation_.load(std::memory_order_acquire); }
+    // Blocks until every requested pipeline was compiled
+    void wait_idle();
+    // Destroys every pipeline after waiting for compilations in progress, e.g. before destroying the render pass they use.
+    // Previously returned ids become invalid. Must only be called when no pending command buffer uses the pipelines.
+    void clear();
+
+private:
+    struct Entry {
+        PipelineKey key;
+        std::optional<PipelineId> fallback;
+        vk::UniquePipeline pipeline;
+        // Set once pipeline is, null if it isn't ready or failed to compile
+        std::atomic<VkPipeline> ready{VK_NULL_HANDLE};
+    };
+
+    // Entries never move, so get() can read them without locking while others are added
+    static const uint32_t CAPACITY = 256;
+
+    const vk::Device device_;
+    const vk::PipelineCache pipeline_cache_;
+    const vk::AllocationCallbacks* const allocation_callbacks_;
+    const std::unique_ptr<Entry[]> entries_;
+    std::atomic<uint32_t> generation_{0};
+    std::mutex mutex_;
+    std::condition_variable compile_pending_;
+    std::condition_variable compile_finished_;
+    std::unordered_map<PipelineKey, PipelineId, PipelineKeyHash> ids_;
+    uint32_t entry_count_ = 0;
+    std::deque<PipelineId> queue_;
+    uint32_t compiling_count_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    void work();
+    vk::UniquePipeline compile(const PipelineKey& key) const;
+};
+
+#endif
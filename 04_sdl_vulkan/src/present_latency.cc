@@ -0,0 +1,60 @@
+#include "present_latency.hh"
+
+namespace {
+// Bounds how long drop_pending() may block if a present is never shown, e.g. for a minimized window
+const uint64_t WAIT_TIMEOUT_NS = 100'000'000;
+}
+
+PresentLatencyMonitor::PresentLatencyMonitor(vk::Device device, PFN_vkWaitForPresentKHR wait_for_present) :
+    device_(device), wait_for_present_(wait_for_present), thread_(&PresentLatencyMonitor::work, this) {}
+
+PresentLatencyMonitor::~PresentLatencyMonitor() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    present_pending_.notify_one();
+    thread_.join();
+}
+
+void PresentLatencyMonitor::presented(vk::SwapchainKHR swapchain, uint64_t present_id) {
+    const auto now = Clock::now();
+    {
+        std::lock_guard lock(mutex_);
+        if (pending_count_ == pending_.size())
+            return;
+        pending_[(pending_head_ + pending_count_++) % pending_.size()] = {swapchain, present_id, now};
+    }
+    present_pending_.notify_one();
+}
+
+void PresentLatencyMonitor::drop_pending() {
+    std::unique_lock lock(mutex_);
+    pending_count_ = 0;
+    wait_finished_.wait(lock, [this] { return !waiting_; });
+}
+
+void PresentLatencyMonitor::work() {
+    for (;;) {
+        Present present;
+        {
+            std::unique_lock lock(mutex_);
+            present_pending_.wait(lock, [this] { return stopping_ || pending_count_; });
+            if (stopping_)
+                return;
+            present = pending_[pending_head_];
+            pending_head_ = (pending_head_ + 1) % pending_.size();
+            pending_count_--;
+            waiting_ = true;
+        }
+        const auto result = static_cast<vk::Result>(wait_for_present_(device_, static_cast<VkSwapchainKHR>(present.swapchain), present.id, WAIT_TIMEOUT_NS));
+        const std::chrono::duration<float, std::milli> latency = Clock::now() - present.time;
+        {
+            std::lock_guard lock(mutex_);
+            waiting_ = false;
+        }
+        wait_finished_.notify_all();
+        if (result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR)
+            latest_ms_.store(latency.count(), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PRESENT_LATENCY_HH_
+#define PRESENT_LATENCY_HH_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <vulkan/vulkan.hpp>
+
+// Measures the time from vkQueuePresentKHR until the image is shown, using VK_KHR_present_wait. A thread waits for the
+// presents in turn, so the render loop never blocks on them.
+class PresentLatencyMonitor {
+public:
+    PresentLatencyMonitor(vk::Device device, PFN_vkWaitForPresentKHR wait_for_present);
+    PresentLatencyMonitor(const PresentLatencyMonitor&) = delete;
+    PresentLatencyMonitor& operator=(const PresentLatencyMonitor&) = delete;
+    ~PresentLatencyMonitor();
+
+    // Must be called right after presenting with a VkPresentIdKHR of present_id. Presents are dropped if too many are pending.
+    void presented(vk::SwapchainKHR swapchain, uint64_t present_id);
+    // Forgets the pending presents and returns once no wait is in progress. Must be called before destroying a swapchain.
+    void drop_pending();
+    // Latency of the last present shown since the previous call, negative if none was
+    float take_latest_ms() { return latest_ms_.exchange(-1, std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Present {
+        vk::SwapchainKHR swapchain;
+        uint64_t id;
+        Clock::time_point time;
+    };
+
+    const vk::Device device_;
+    const PFN_vkWaitForPresentKHR wait_for_present_;
+    std::mutex mutex_;
+    std::condition_variable present_pending_;
+    std::condition_variable wait_finished_;
+    // Ring of pending presents, fixed size so presenting doesn't allocate
+    std::array<Present, 8> pending_;
+    size_t pending_head_ = 0;
+    size_t pending_count_ = 0;
+    bool waiting_ = false;
+    bool stopping_ = false;
+    std::atomic<float> latest_ms_{-1};
+    std::thread thread_;
+
+    void work();
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "profiler.hh"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+struct Column {
+    const char* name;
+    float FrameRecord::*field;
+};
+
+const std::array<Column, 9> COLUMNS = {{
+    {"frame_ms", &FrameRecord::frame_ms},
+    {"wait_ms", &FrameRecord::wait_ms},
+    {"acquire_ms", &FrameRecord::acquire_ms},
+    {"record_ms", &FrameRecord::record_ms},
+    {"submit_ms", &FrameRecord::submit_ms},
+    {"present_ms", &FrameRecord::present_ms},
+    {"present_latency_ms", &FrameRecord::present_latency_ms},
+    {"gpu_ms", &FrameRecord::gpu_ms},
+    {"recreate_ms", &FrameRecord::recreate_ms},
+}};
+
+struct Percentiles {
+    float p50, p99, max;
+    size_t samples;
+};
+
+Percentiles percentiles(const std::vector<FrameRecord>& records, float FrameRecord::*field) {
+    std::vector<float> values;
+    values.reserve(records.size());
+    for (const auto& record : records) {
+        // Negative values mark missing samples
+        if (record.*field >= 0)
+            values.push_back(record.*field);
+    }
+    if (values.empty())
+        return {0, 0, 0, 0};
+    std::sort(values.begin(), values.end());
+    const auto at = [&values](double percentile) { return values[static_cast<size_t>(percentile * (values.size() - 1) + .5)]; };
+    return {at(.5), at(.99), values.back(), values.size()};
+}
+}
+
+Profiler::Profiler(size_t capacity) : capacity_(capacity), slots_(std::make_unique<Slot[]>(capacity)) {}
+
+void Profiler::push(const FrameRecord& record) {
+    const auto count = count_.load(std::memory_order_relaxed);
+    auto& slot = slots_[count % capacity_];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    // Orders the invalidation before the record is written
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.sequence.store(count + 1, std::memory_order_release);
+    count_.store(count + 1, std::memory_order_release);
+}
+
+std::vector<FrameRecord> Profiler::snapshot() const {
+    const auto count = count_.load(std::memory_order_acquire);
+    const auto first = count > capacity_ ? count - capacity_ : 0;
+    std::vector<FrameRecord> records;
+    records.reserve(count - first);
+    for (auto i = first; i < count; i++) {
+        const auto& slot = slots_[i % capacity_];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto record = slot.record;
+        // Orders the copy before the sequence is checked again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Records the producer overwrote, or was writing, while they were copied are dropped
+        if (sequence == i + 1 && slot.sequence.load(std::memory_order_relaxed) == i + 1)
+            records.push_back(record);
+    }
+    return records;
+}
+
+void Profiler::write_csv(std::ostream& stream) const {
+    stream << "frame";
+    for (const auto& column : COLUMNS)
+        stream << "," << column.name;
+    stream << "\n";
+    for (const auto& record : snapshot()) {
+        stream << record.frame;
+        for (const auto& column : COLUMNS)
+            stream << "," << record.*column.field;
+        stream << "\n";
+    }
+}
+
+void Profiler::write_json(std::ostream& stream) const {
+    const auto records = snapshot();
+    stream << "{\n  \"summary\": {";
+    for (size_t i = 0; i < COLUMNS.size(); i++) {
+        const auto summary = percentiles(records, COLUMNS[i].field);
+        stream << (i ? ",\n" : "\n") << "    \"" << COLUMNS[i].name << "\": {\"samples\": " << summary.samples << ", \"p50\": " << summary.p50
+               << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+    }
+    stream << "\n  },\n  \"frames\": [";
+    for (size_t i = 0; i < records.size(); i++) {
+        stream << (i ? ",\n" : "\n") << "    {\"frame\": " << records[i].frame;
+        for (const auto& column : COLUMNS)
+            stream << ", \"" << column.name << "\": " << records[i].*column.field;
+        stream << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+void Profiler::write_summary(std::ostream& stream) const {
+    const auto records = snapshot();
+    stream << "Frame timings over " << records.size() << " frames (ms):\n";
+    for (const auto& column : COLUMNS) {
+        const auto summary = percentiles(records, column.field);
+        stream << "\t" << column.name << "\tp50 " << summary.p50 << "\tp99 " << summary.p99 << "\tmax " << summary.max << "\n";
+    }
+}
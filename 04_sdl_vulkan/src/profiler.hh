@@ -0,0 +1,66 @@
+#ifndef PROFILER_HH_
+#define PROFILER_HH_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// Timings of a single call to Vulkan::draw_frame, in milliseconds
+struct FrameRecord {
+    uint64_t frame;
+    // Time since the previous frame started
+    float frame_ms;
+    // Waiting for the frame slot and image fences
+    float wait_ms;
+    float acquire_ms;
+    // Recording the command buffer, negative if it was recorded in advance
+    float record_ms;
+    float submit_ms;
+    float present_ms;
+    // Time from an earlier present until its image was shown, measured asynchronously. Negative if none was shown
+    // since the previous frame, or if VK_KHR_present_wait is unavailable.
+    float present_latency_ms;
+    // GPU time of the render pass of the previous frame that used the acquired image, negative if unavailable
+    float gpu_ms;
+    // Recreating the render target after this frame, negative if it wasn't recreated
+    float recreate_ms;
+};
+
+// Fixed size ring of frame records. A single thread pushes, any thread may take snapshots, none of them locks.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Profiler(size_t capacity);
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void push(const FrameRecord& record);
+    // Returns the most recent records, oldest first
+    [[nodiscard]] std::vector<FrameRecord> snapshot() const;
+
+    void write_csv(std::ostream& stream) const;
+    void write_json(std::ostream& stream) const;
+    // Prints p50/p99/max of each phase
+    void write_summary(std::ostream& stream) const;
+
+    static float elapsed_ms(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+private:
+    struct Slot {
+        // One more than the index of the record in the slot, 0 while it is written, so readers detect torn copies
+        std::atomic<uint64_t> sequence{0};
+        FrameRecord record;
+    };
+
+    const size_t capacity_;
+    const std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> count_ = 0;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "redraw_scheduler.hh"
+
+#include <algorithm>
+
+namespace {
+// First interval once idle, if the active one is shorter
+const RedrawScheduler::Clock::duration MIN_IDLE_INTERVAL = std::chrono::milliseconds(33);
+}
+
+RedrawScheduler::RedrawScheduler(Clock::duration active_interval, Clock::duration idle_interval, Clock::duration idle_delay) :
+    active_interval_(active_interval), idle_interval_(std::max(idle_interval, active_interval)), idle_delay_(idle_delay), interval_(active_interval),
+    last_input_(Clock::now()) {}
+
+void RedrawScheduler::input(Clock::time_point now) {
+    last_input_ = now;
+    interval_ = active_interval_;
+}
+
+std::optional<RedrawScheduler::Clock::duration> RedrawScheduler::time_until_frame(Clock::time_point now) const {
+    if (!dirty_)
+        return std::nullopt;
+    return std::max(last_frame_ + interval_ - now, Clock::duration::zero());
+}
+
+bool RedrawScheduler::begin_frame(Clock::time_point now) {
+    if (!dirty_ || now < last_frame_ + interval_)
+        return false;
+    dirty_ = false;
+    last_frame_ = now;
+    if (now - last_input_ >= idle_delay_)
+        interval_ = std::min(std::max(2 * interval_, MIN_IDLE_INTERVAL), idle_interval_);
+    return true;
+}
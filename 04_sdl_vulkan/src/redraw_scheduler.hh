@@ -0,0 +1,34 @@
+#ifndef REDRAW_SCHEDULER_HH_
+#define REDRAW_SCHEDULER_HH_
+
+#include <chrono>
+#include <optional>
+
+// Decides when on-demand rendering draws a frame. Nothing is drawn unless something was invalidated. While the user
+// interacts, frames are drawn at most every active_interval. After idle_delay without input the interval doubles with
+// each frame, up to idle_interval, so a scene that keeps invalidating itself costs little when nobody is looking.
+class RedrawScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RedrawScheduler(Clock::duration active_interval, Clock::duration idle_interval, Clock::duration idle_delay);
+
+    void invalidate() { dirty_ = true; }
+    void input(Clock::time_point now);
+    // Time left until the next frame is due, or std::nullopt if nothing needs to be drawn
+    [[nodiscard]] std::optional<Clock::duration> time_until_frame(Clock::time_point now) const;
+    // Returns whether a frame is due. If so, the scheduler is no longer dirty and the next frame is scheduled.
+    bool begin_frame(Clock::time_point now);
+
+private:
+    const Clock::duration active_interval_;
+    const Clock::duration idle_interval_;
+    const Clock::duration idle_delay_;
+    Clock::duration interval_;
+    Clock::time_point last_frame_;
+    Clock::time_point last_input_;
+    // The first frame must be drawn
+    bool dirty_ = true;
+};
+
+#endif
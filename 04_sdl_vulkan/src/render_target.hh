@@ -0,0 +1,34 @@
+#ifndef RENDER_TARGET_HH_
+#define RENDER_TARGET_HH_
+
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// A set of images the renderer draws into, e.g. a window's swapchain or offscreen images
+class RenderTarget {
+public:
+    RenderTarget() = default;
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+    virtual ~RenderTarget() = default;
+
+    // (Re)creates the images. Must only be called while none of them is in use by the GPU.
+    virtual void recreate() = 0;
+    [[nodiscard]] virtual vk::Format format() const = 0;
+    [[nodiscard]] virtual vk::Extent2D extent() const = 0;
+    // Layout the render pass must leave images in
+    [[nodiscard]] virtual vk::ImageLayout final_layout() const = 0;
+    [[nodiscard]] virtual const std::vector<vk::UniqueImageView>& image_views() const = 0;
+    // Whether acquire() signals and present() waits on the semaphores passed to them
+    [[nodiscard]] virtual bool uses_semaphores() const = 0;
+    // Returns the index of the next image to render to, or std::nullopt if the target is outdated and must be recreated
+    virtual std::optional<uint32_t> acquire(vk::Semaphore image_available) = 0;
+    // Returns false if the target is outdated or suboptimal and should be recreated
+    virtual bool present(uint32_t image_index, vk::Semaphore render_finished) = 0;
+    // Time from a previous present until its image was shown, negative if none was shown since the last call or it can't be measured
+    virtual float take_present_latency_ms() { return -1; }
+};
+
+#endif
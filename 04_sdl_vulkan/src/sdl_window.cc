@@ -4,6 +4,7 @@
 
 #include <SDL2/SDL_vulkan.h>
 
+#include "log.hh"
 #include "quit_exception.hh"
 
 const int WIDTH = 800;
@@ -49,8 +50,6 @@ std::pair<int, int> SDLWindow::get_drawable_size() const {
     return {width, height};
 }
 
-#include <iostream>
-
 void SDLWindow::wait_window_show_event() {
     SDL_Event event;
     // while (SDL_WaitEvent(&event)) {
@@ -62,7 +61,7 @@ void SDLWindow::wait_window_show_event() {
             switch (event.window.event) {
             case SDL_WINDOWEVENT_EXPOSED:
             case SDL_WINDOWEVENT_SIZE_CHANGED:
-                std::cout << "SDL_WINDOWEVENT\n";
+                log_debug("Window shown");
                 return;
             }
         }
@@ -86,11 +85,44 @@ bool SDLWindow::pool() {
             }
         }
     } while (SDL_PollEvent(&event));
-    std::cout << "Event - needs_redraw = " << needs_redraw << "\n";
-    return true;
     return needs_redraw;
 }
 
+void SDLWindow::poll_events() {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT)
+            throw quit_exception();
+    }
+}
+
+std::optional<WindowEvent> SDLWindow::wait_event(int timeout_ms) const {
+    SDL_Event event;
+    if (!SDL_WaitEventTimeout(&event, timeout_ms))
+        return std::nullopt;
+    switch (event.type) {
+    case SDL_QUIT:
+        return WindowEvent{WindowEvent::Type::quit};
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEWHEEL:
+        return WindowEvent{WindowEvent::Type::input};
+    case SDL_WINDOWEVENT:
+        switch (event.window.event) {
+        case SDL_WINDOWEVENT_EXPOSED:
+            return WindowEvent{WindowEvent::Type::expose};
+        case SDL_WINDOWEVENT_SIZE_CHANGED: {
+            const auto [width, height] = get_drawable_size();
+            return WindowEvent{WindowEvent::Type::resize, width, height};
+        }
+        }
+    }
+    return std::nullopt;
+}
+
 SDLWindow::~SDLWindow() {
     SDL_DestroyWindow(window);
     SDL_Quit();
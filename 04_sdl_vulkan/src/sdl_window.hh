@@ -1,11 +1,14 @@
 #ifndef SDL_WINDOW_HH_
 #define SDL_WINDOW_HH_
 
+#include <optional>
 #include <vector>
 
 #include <SDL2/SDL.h>
 #include <vulkan/vulkan.h>
 
+#include "window_event.hh"
+
 class SDLWindow {
 public:
     SDLWindow();
@@ -14,7 +17,11 @@ public:
     [[nodiscard]] std::vector<const char*> get_vulkan_extensions() const;
     [[nodiscard]] VkSurfaceKHR create_vulkan_surface(const VkInstance& instance);
     [[nodiscard]] std::pair<int, int> get_drawable_size() const;
+    // Blocks until events arrive, returns whether the window must be redrawn
     bool pool();
+    void poll_events();
+    // Waits up to timeout_ms (forever if negative) for an SDL event, returns it if the renderer needs to know about it
+    std::optional<WindowEvent> wait_event(int timeout_ms) const;
     static void wait_window_show_event();
     ~SDLWindow();
 
@@ -1,9 +1,17 @@
 #version 460
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec3 fragColor;
+// Shading enum in options.hh: 0 for vertex colors tinted by the instance color, 1 for the instance color only, 2 for
+// grayscale tinted vertex colors. Resolved when the pipeline is compiled, so only the chosen branch remains.
+layout(constant_id = 0) const uint SHADING = 0;
+
+layout(location = 0) in vec3 vertexColor;
+layout(location = 1) in vec3 instanceColor;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = SHADING == 1 ? instanceColor : vertexColor * instanceColor;
+    if (SHADING == 2)
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    outColor = vec4(color, 1.0);
 }
@@ -3,10 +3,31 @@
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
+// Offset in xy, scale in z, rotation in w
+layout(location = 2) in vec4 inInstanceTransform;
+layout(location = 3) in vec4 inInstanceColor;
 
-layout(location = 0) out vec3 fragColor;
+// FrameUniforms in vulkan.cc, written once per frame into the uniform ring and read through a dynamic offset
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    // Radians added to the rotation of even instances and subtracted from odd ones
+    float rotation;
+} frame;
+
+// DrawConstants in vulkan.cc, pushed before the draws they apply to
+layout(push_constant) uniform DrawConstants {
+    // Scale in xy and offset in zw, applied after the instance transform
+    vec4 view;
+} draw;
+
+layout(location = 0) out vec3 vertexColor;
+layout(location = 1) out vec3 instanceColor;
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+    float angle = inInstanceTransform.w + ((gl_InstanceIndex & 1) == 0 ? frame.rotation : -frame.rotation);
+    float c = cos(angle);
+    float s = sin(angle);
+    vec2 position = mat2(c, s, -s, c) * inPosition * inInstanceTransform.z + inInstanceTransform.xy;
+    gl_Position = vec4(position * draw.view.xy + draw.view.zw, 0.0, 1.0);
+    vertexColor = inColor;
+    instanceColor = inInstanceColor.rgb;
 }
@@ -0,0 +1,70 @@
+#ifndef SPECIALIZATION_HH_
+#define SPECIALIZATION_HH_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <vulkan/vulkan.hpp>
+
+const uint32_t MAX_SPECIALIZATION_CONSTANTS = 8;
+
+// Values for a shader's specialization constants, so variants of one SPIR-V module are compiled with their branches
+// resolved instead of branching at runtime. Built from a typed description: a struct of scalar members with a
+// constexpr static get_map_entries() tying each member to a constant_id, e.g.
+//     struct Constants {
+//         VkBool32 feature;
+//         constexpr static auto get_map_entries() {
+//             return std::array<vk::SpecializationMapEntry, 1> {vk::SpecializationMapEntry(0, offsetof(Constants, feature), sizeof(VkBool32))};
+//         }
+//     };
+// Holds a copy of the values, so it can be compared, hashed and outlive the description. Booleans must be VkBool32.
+class SpecializationConstants {
+public:
+    SpecializationConstants() = default;
+
+    template <typename Constants>
+    static SpecializationConstants from(const Constants& constants) {
+        static_assert(std::is_trivially_copyable_v<Constants> && sizeof(Constants) <= sizeof(data_), "Unsupported specialization constants");
+        constexpr auto map_entries = Constants::get_map_entries();
+        static_assert(map_entries.size() <= MAX_SPECIALIZATION_CONSTANTS, "Too many specialization constants");
+        SpecializationConstants result;
+        std::copy(map_entries.begin(), map_entries.end(), result.map_entries_.begin());
+        result.count_ = map_entries.size();
+        result.size_ = sizeof(Constants);
+        // Only mapped bytes are copied, padding stays zero so equal values compare equal
+        for (const auto& entry : map_entries)
+            std::memcpy(result.data_.data() + entry.offset, reinterpret_cast<const char*>(&constants) + entry.offset, entry.size);
+        return result;
+    }
+
+    [[nodiscard]] bool empty() const { return !count_; }
+    // Points into this object, which must outlive it
+    [[nodiscard]] vk::SpecializationInfo info() const { return vk::SpecializationInfo(count_, map_entries_.data(), size_, data_.data()); }
+
+    bool operator==(const SpecializationConstants& other) const {
+        return count_ == other.count_ && size_ == other.size_ && map_entries_ == other.map_entries_ && data_ == other.data_;
+    }
+
+    [[nodiscard]] size_t hash() const {
+        size_t seed = count_;
+        for (uint32_t i = 0; i < count_; i++) {
+            const auto& entry = map_entries_[i];
+            uint32_t value = 0;
+            std::memcpy(&value, data_.data() + entry.offset, std::min<size_t>(entry.size, sizeof(value)));
+            seed ^= static_cast<size_t>(uint64_t(entry.constantID) << 32 | value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+
+private:
+    std::array<vk::SpecializationMapEntry, MAX_SPECIALIZATION_CONSTANTS> map_entries_{};
+    uint32_t count_ = 0;
+    size_t size_ = 0;
+    // Zero-initialized, so unmapped bytes don't affect comparisons
+    std::array<char, 8 * MAX_SPECIALIZATION_CONSTANTS> data_{};
+};
+
+#endif
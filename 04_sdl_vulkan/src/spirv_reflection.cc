@@ -0,0 +1,134 @@
+#include "spirv_reflection.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "log.hh"
+
+namespace {
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const size_t HEADER_WORDS = 5;
+
+// From the SPIR-V specification
+const uint32_t OP_TYPE_INT = 21;
+const uint32_t OP_TYPE_FLOAT = 22;
+const uint32_t OP_TYPE_VECTOR = 23;
+const uint32_t OP_TYPE_POINTER = 32;
+const uint32_t OP_VARIABLE = 59;
+const uint32_t OP_DECORATE = 71;
+const uint32_t DECORATION_BUILT_IN = 11;
+const uint32_t DECORATION_LOCATION = 30;
+const uint32_t STORAGE_CLASS_INPUT = 1;
+
+const char* to_string(ComponentType type) {
+    switch (type) {
+    case ComponentType::floating:
+        return "float";
+    case ComponentType::signed_integer:
+        return "int";
+    case ComponentType::unsigned_integer:
+        return "uint";
+    }
+    return "unknown";
+}
+}
+
+std::vector<ShaderInput> reflect_inputs(const uint32_t* spirv, size_t size) {
+    const auto word_count = size / sizeof(uint32_t);
+    if (word_count < HEADER_WORDS || spirv[0] != SPIRV_MAGIC)
+        throw std::runtime_error("Invalid SPIR-V header");
+
+    struct Type {
+        ComponentType component_type;
+        uint32_t component_count = 0;
+    };
+    std::unordered_map<uint32_t, Type> types;
+    // Pointer type to pointee type
+    std::unordered_map<uint32_t, uint32_t> pointers;
+    std::unordered_map<uint32_t, uint32_t> locations;
+    std::vector<uint32_t> built_ins;
+    // Input variable to its pointer type
+    std::vector<std::pair<uint32_t, uint32_t>> variables;
+
+    for (size_t i = HEADER_WORDS; i < word_count;) {
+        const auto length = spirv[i] >> 16;
+        const auto opcode = spirv[i] & 0xffff;
+        if (!length || i + length > word_count)
+            throw std::runtime_error("Truncated SPIR-V instruction");
+        const auto operands = spirv + i + 1;
+        // Checked before reading operands, the last instruction of a malformed module could end early
+        const auto require_operands = [operand_count = length - 1](uint32_t count) {
+            if (operand_count < count)
+                throw std::runtime_error("Malformed SPIR-V instruction");
+        };
+        switch (opcode) {
+        case OP_TYPE_INT:
+            require_operands(3);
+            types[operands[0]] = {operands[2] ? ComponentType::signed_integer : ComponentType::unsigned_integer, 1};
+            break;
+        case OP_TYPE_FLOAT:
+            require_operands(2);
+            types[operands[0]] = {ComponentType::floating, 1};
+            break;
+        case OP_TYPE_VECTOR:
+            require_operands(3);
+            if (const auto component = types.find(operands[1]); component != types.end())
+                types[operands[0]] = {component->second.component_type, operands[2]};
+            break;
+        case OP_TYPE_POINTER:
+            require_operands(3);
+            pointers[operands[0]] = operands[2];
+            break;
+        case OP_VARIABLE:
+            require_operands(3);
+            if (operands[2] == STORAGE_CLASS_INPUT)
+                variables.emplace_back(operands[1], operands[0]);
+            break;
+        case OP_DECORATE:
+            require_operands(2);
+            if (operands[1] == DECORATION_LOCATION) {
+                require_operands(3);
+                locations[operands[0]] = operands[2];
+            } else if (operands[1] == DECORATION_BUILT_IN) {
+                built_ins.push_back(operands[0]);
+            }
+            break;
+        }
+        i += length;
+    }
+
+    std::vector<ShaderInput> inputs;
+    for (const auto& [variable, pointer_type] : variables) {
+        if (std::find(built_ins.begin(), built_ins.end(), variable) != built_ins.end())
+            continue;
+        const auto location = locations.find(variable);
+        const auto type = types.find(pointers[pointer_type]);
+        if (location == locations.end() || type == types.end())
+            throw std::runtime_error("Unsupported shader input " + std::to_string(variable));
+        inputs.push_back({location->second, type->second.component_count, type->second.component_type});
+    }
+    return inputs;
+}
+
+void check_vertex_inputs(const std::vector<ShaderInput>& inputs, const vk::VertexInputAttributeDescription* attributes, uint32_t attribute_count) {
+    const auto attributes_end = attributes + attribute_count;
+    for (const auto& input : inputs) {
+        const auto attribute = std::find_if(attributes, attributes_end, [&input](const auto& attribute) { return attribute.location == input.location; });
+        if (attribute == attributes_end)
+            throw std::runtime_error("No vertex attribute for shader input location " + std::to_string(input.location));
+        const auto format_info = get_format_info(attribute->format);
+        if (format_info.component_type != input.component_type)
+            throw std::runtime_error("Vertex attribute at location " + std::to_string(input.location) + " provides " + to_string(format_info.component_type)
+                    + " components to a " + to_string(input.component_type) + " shader input");
+        // Extra components are dropped, which packed formats rely on, e.g. RGBA8 for a vec3
+        if (format_info.component_count < input.component_count)
+            log_warning("Vertex attribute at location ", input.location, " has ", format_info.component_count, " components, the shader input ", input.component_count,
+                    ", the missing ones read as 0 and w as 1");
+    }
+    for (auto attribute = attributes; attribute != attributes_end; attribute++) {
+        if (std::none_of(inputs.begin(), inputs.end(), [attribute](const ShaderInput& input) { return input.location == attribute->location; }))
+            log_warning("Vertex attribute at location ", attribute->location, " is fetched but not read by the shader");
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SPIRV_REFLECTION_HH_
+#define SPIRV_REFLECTION_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vertex_layout.hh"
+
+// A user defined input variable of a shader, built-ins are skipped
+struct ShaderInput {
+    uint32_t location;
+    uint32_t component_count;
+    ComponentType component_type;
+};
+
+// Throws std::runtime_error if the code isn't valid SPIR-V. Only scalar and vector inputs are supported.
+std::vector<ShaderInput> reflect_inputs(const uint32_t* spirv, size_t size);
+
+// Throws std::runtime_error if a vertex shader input is fed by no attribute or one of another component type. Attributes
+// no input reads only cost bandwidth and are reported as warnings, as are attributes with fewer components than their input.
+void check_vertex_inputs(const std::vector<ShaderInput>& inputs, const vk::VertexInputAttributeDescription* attributes, uint32_t attribute_count);
+
+#endif
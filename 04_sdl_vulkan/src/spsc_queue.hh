@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_HH_
+#define SPSC_QUEUE_HH_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Bounded lock-free queue for one producer thread and one consumer thread. Each side caches the other side's index
+// and only reloads it when the queue looks full or empty, so the indices' cache lines are rarely shared.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity && !(Capacity & (Capacity - 1)), "Capacity must be a power of two");
+
+public:
+    // Producer only. Returns false if the queue is full.
+    bool push(const T& value) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity)
+                return false;
+        }
+        slots_[tail % Capacity] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        tail_.notify_one();
+        return true;
+    }
+
+    // Consumer only. Returns std::nullopt if the queue is empty.
+    std::optional<T> pop() {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+                return std::nullopt;
+        }
+        T value = slots_[head % Capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    // Consumer only. Blocks until an element is available.
+    T wait_pop() {
+        for (;;) {
+            if (auto value = pop())
+                return *value;
+            tail_.wait(head_.load(std::memory_order_relaxed), std::memory_order_acquire);
+        }
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    // Consumer's copy of tail_
+    size_t tail_cache_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    // Producer's copy of head_
+    size_t head_cache_ = 0;
+    alignas(64) std::array<T, Capacity> slots_;
+};
+
+#endif
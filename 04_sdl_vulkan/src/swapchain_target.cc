@@ -0,0 +1,187 @@
+#include "swapchain_target.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "log.hh"
+
+namespace {
+// In order of preference. FIFO is always supported.
+std::vector<vk::PresentModeKHR> preferred_present_modes(PresentPolicy policy) {
+    switch (policy) {
+    case PresentPolicy::low_latency:
+        return {vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eFifo};
+    case PresentPolicy::relaxed:
+        return {vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo};
+    case PresentPolicy::vsync:
+        break;
+    }
+    return {vk::PresentModeKHR::eFifo};
+}
+}
+
+SwapchainTarget::SwapchainTarget(vk::PhysicalDevice physical_device, vk::Device device, vk::SurfaceKHR surface, uint32_t graphics_queue_family_index, uint32_t present_queue_family_index,
+        vk::Queue present_queue, std::function<std::pair<int, int>()> get_extent, std::function<void()> wait_window_show_event, PresentPolicy present_policy,
+        uint32_t image_count, PFN_vkWaitForPresentKHR wait_for_present, bool present_fences, const vk::AllocationCallbacks* allocation_callbacks) :
+    physical_device_(physical_device), device_(device), surface_(surface), graphics_queue_family_index_(graphics_queue_family_index), present_queue_family_index_(present_queue_family_index),
+    present_queue_(present_queue), get_extent_(std::move(get_extent)), wait_window_show_event_(std::move(wait_window_show_event)), present_policy_(present_policy),
+    requested_image_count_(image_count), latency_monitor_(wait_for_present ? std::make_unique<PresentLatencyMonitor>(device, wait_for_present) : nullptr),
+    use_present_fences_(present_fences), allocation_callbacks_(allocation_callbacks) {}
+
+SwapchainTarget::~SwapchainTarget() {
+    // The monitor's thread may be waiting on the swapchain
+    if (latency_monitor_)
+        latency_monitor_->drop_pending();
+}
+
+void SwapchainTarget::recreate() {
+    create_swapchain();
+    create_image_views();
+}
+
+vk::SurfaceCapabilitiesKHR SwapchainTarget::update_surface_capabilities() {
+    for (;;) {
+        auto capabilities = physical_device_.getSurfaceCapabilitiesKHR(surface_);
+        // "currentExtent is the current width and height of the surface, or the special value (0xFFFFFFFF, 0xFFFFFFFF) indicating
+        // that the surface size will be determined by the extent of a swapchain targeting the surface"
+        if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max() || capabilities.currentExtent.height != std::numeric_limits<uint32_t>::max()) {
+            extent_ = capabilities.currentExtent;
+        } else {
+            std::tie(extent_.width, extent_.height) = get_extent_();
+            extent_.width = std::clamp(extent_.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+            extent_.height = std::clamp(extent_.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+        }
+        // "On some platforms, it is normal that maxImageExtent may become (0, 0), for example when the window is minimized.
+        // In such a case, it is not possible to create a swapchain due to the Valid Usage requirements."
+        if (extent_.width && extent_.height)
+            return capabilities;
+        wait_window_show_event_();
+    }
+}
+
+void SwapchainTarget::create_swapchain() {
+    const auto capabilities = update_surface_capabilities();
+    uint32_t image_count = std::max(requested_image_count_ ? requested_image_count_ : capabilities.minImageCount + 1, capabilities.minImageCount);
+    if (capabilities.maxImageCount && image_count > capabilities.maxImageCount) {
+        image_count = capabilities.maxImageCount;
+    }
+    present_mode_ = choose_present_mode();
+
+    const auto formats = physical_device_.getSurfaceFormatsKHR(surface_);
+    vk::SurfaceFormatKHR chosen_format = formats[0];
+    for (const auto& format : formats) {
+        // TODO check for other sRGB colorspaces? One of them must be available:
+        // "Vulkan requires that all implementations support the sRGB transfer function by use of an SRGB pixel format"
+        if (format.format == vk::Format::eB8G8R8Unorm && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
+            chosen_format = format;
+            break;
+        }
+    }
+    format_ = chosen_format.format;
+
+    vk::SwapchainCreateInfoKHR create_info(vk::SwapchainCreateFlagsKHR(), surface_, image_count, chosen_format.format, chosen_format.colorSpace, extent_, 1,
+            vk::ImageUsageFlagBits::eColorAttachment, vk::SharingMode::eExclusive, 0, nullptr, capabilities.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque,
+            present_mode_, true, *swapchain_);
+    std::array<uint32_t, 2> queue_family_indices;
+    if (graphics_queue_family_index_ != present_queue_family_index_) {
+        queue_family_indices = {graphics_queue_family_index_, present_queue_family_index_};
+        create_info.imageSharingMode = vk::SharingMode::eConcurrent;
+        create_info.queueFamilyIndexCount = 2;
+        create_info.pQueueFamilyIndices = queue_family_indices.data();
+    }
+    // Passing the old swapchain lets the presentation engine hand its resources over to the new one
+    auto swapchain = device_.createSwapchainKHRUnique(create_info, allocation_callbacks_);
+    image_views_.clear();
+    if (swapchain_) {
+        // The old images must not be in use when the old swapchain is destroyed. Only their presentations are waited for,
+        // unless there are no present fences.
+        if (use_present_fences_) {
+            std::vector<vk::Fence> fences;
+            for (const auto& fence : present_fences_)
+                fences.push_back(*fence);
+            if (device_.waitForFences(fences.size(), fences.data(), true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+                throw std::runtime_error("Failed to wait for present fences");
+        } else {
+            present_queue_.waitIdle();
+        }
+        if (latency_monitor_)
+            latency_monitor_->drop_pending();
+    }
+    swapchain_ = std::move(swapchain);
+
+    images_ = device_.getSwapchainImagesKHR(*swapchain_);
+    present_fences_.clear();
+    if (use_present_fences_) {
+        // Signaled, as if each image had been presented
+        for (size_t i = 0; i < images_.size(); i++)
+            present_fences_.push_back(device_.createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled), allocation_callbacks_));
+    }
+    log_info("Swapchain of ", images_.size(), " images presenting in ", vk::to_string(present_mode_), " mode");
+}
+
+vk::PresentModeKHR SwapchainTarget::choose_present_mode() const {
+    const auto supported_modes = physical_device_.getSurfacePresentModesKHR(surface_);
+    for (const auto mode : preferred_present_modes(present_policy_)) {
+        if (std::find(supported_modes.begin(), supported_modes.end(), mode) != supported_modes.end())
+            return mode;
+    }
+    return vk::PresentModeKHR::eFifo;
+}
+
+void SwapchainTarget::create_image_views() {
+    image_views_.resize(images_.size());
+    for (unsigned i = 0; i < images_.size(); i++) {
+        const vk::ImageViewCreateInfo create_info(vk::ImageViewCreateFlags(), images_[i], vk::ImageViewType::e2D, format_,
+                vk::ComponentMapping(), vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        image_views_[i] = device_.createImageViewUnique(create_info, allocation_callbacks_);
+    }
+}
+
+// Out of date and suboptimal swapchains are expected while resizing, so they are handled through result codes rather than
+// exceptions, which are slow to throw repeatedly
+std::optional<uint32_t> SwapchainTarget::acquire(vk::Semaphore image_available) {
+    uint32_t image_index;
+    const auto result = device_.acquireNextImageKHR(*swapchain_, std::numeric_limits<uint64_t>::max(), image_available, nullptr, &image_index);
+    switch (result) {
+    case vk::Result::eSuccess:
+    case vk::Result::eSuboptimalKHR:
+        suboptimal_ = result == vk::Result::eSuboptimalKHR;
+        return image_index;
+    case vk::Result::eErrorOutOfDateKHR:
+        return std::nullopt;
+    default:
+        throw std::runtime_error("Failed to acquire a swapchain image: " + vk::to_string(result));
+    }
+}
+
+bool SwapchainTarget::present(uint32_t image_index, vk::Semaphore render_finished) {
+    vk::PresentInfoKHR present_info(1, &render_finished, 1, &*swapchain_, &image_index);
+    const auto present_id = ++present_id_;
+    const vk::PresentIdKHR present_id_info(1, &present_id);
+    if (latency_monitor_)
+        present_info.pNext = &present_id_info;
+    vk::Fence present_fence;
+    vk::SwapchainPresentFenceInfoEXT present_fence_info;
+    if (use_present_fences_) {
+        // Signaled long ago in practice, the image was acquired again after its previous presentation
+        present_fence = *present_fences_[image_index];
+        if (device_.waitForFences(1, &present_fence, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess
+                || device_.resetFences(1, &present_fence) != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to reset present fence");
+        present_fence_info = vk::SwapchainPresentFenceInfoEXT(1, &present_fence, present_info.pNext);
+        present_info.pNext = &present_fence_info;
+    }
+    const auto result = present_queue_.presentKHR(&present_info);
+    switch (result) {
+    case vk::Result::eSuccess:
+    case vk::Result::eSuboptimalKHR:
+        if (latency_monitor_)
+            latency_monitor_->presented(*swapchain_, present_id);
+        return result == vk::Result::eSuccess && !suboptimal_;
+    case vk::Result::eErrorOutOfDateKHR:
+        return false;
+    default:
+        throw std::runtime_error("Failed to present: " + vk::to_string(result));
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SWAPCHAIN_TARGET_HH_
+#define SWAPCHAIN_TARGET_HH_
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "options.hh"
+#include "present_latency.hh"
+#include "render_target.hh"
+
+class SwapchainTarget : public RenderTarget {
+public:
+    // image_count may be 0 to use one more image than the surface's minimum. Present latency is only measured if
+    // wait_for_present isn't null, which requires the presentId and presentWait features. present_fences requires the
+    // swapchainMaintenance1 feature, without it recreation idles the present queue. The swapchain, its image views and
+    // present fences are created with allocation_callbacks, which may be null.
+    SwapchainTarget(vk::PhysicalDevice physical_device, vk::Device device, vk::SurfaceKHR surface, uint32_t graphics_queue_family_index, uint32_t present_queue_family_index,
+            vk::Queue present_queue, std::function<std::pair<int, int>()> get_extent, std::function<void()> wait_window_show_event, PresentPolicy present_policy,
+            uint32_t image_count, PFN_vkWaitForPresentKHR wait_for_present, bool present_fences, const vk::AllocationCallbacks* allocation_callbacks);
+    ~SwapchainTarget() override;
+
+    void recreate() override;
+    [[nodiscard]] vk::Format format() const override { return format_; }
+    [[nodiscard]] vk::Extent2D extent() const override { return extent_; }
+    [[nodiscard]] vk::ImageLayout final_layout() const override { return vk::ImageLayout::ePresentSrcKHR; }
+    [[nodiscard]] const std::vector<vk::UniqueImageView>& image_views() const override { return image_views_; }
+    [[nodiscard]] bool uses_semaphores() const override { return true; }
+    std::optional<uint32_t> acquire(vk::Semaphore image_available) override;
+    bool present(uint32_t image_index, vk::Semaphore render_finished) override;
+    float take_present_latency_ms() override { return latency_monitor_ ? latency_monitor_->take_latest_ms() : -1; }
+    [[nodiscard]] vk::PresentModeKHR present_mode() const { return present_mode_; }
+
+private:
+    const vk::PhysicalDevice physical_device_;
+    const vk::Device device_;
+    const vk::SurfaceKHR surface_;
+    const uint32_t graphics_queue_family_index_, present_queue_family_index_;
+    const vk::Queue present_queue_;
+    const std::function<std::pair<int, int>()> get_extent_;
+    const std::function<void()> wait_window_show_event_;
+    const PresentPolicy present_policy_;
+    const uint32_t requested_image_count_;
+    const std::unique_ptr<PresentLatencyMonitor> latency_monitor_;
+    const bool use_present_fences_;
+    const vk::AllocationCallbacks* const allocation_callbacks_;
+    uint64_t present_id_ = 0;
+    vk::PresentModeKHR present_mode_;
+    vk::Extent2D extent_;
+    vk::Format format_;
+    vk::UniqueSwapchainKHR swapchain_;
+    std::vector<vk::Image> images_;
+    std::vector<vk::UniqueImageView> image_views_;
+    // One per image, signaled once its last presentation no longer uses it. Empty without present fences.
+    std::vector<vk::UniqueFence> present_fences_;
+    bool suboptimal_ = false;
+
+    vk::SurfaceCapabilitiesKHR update_surface_capabilities();
+    [[nodiscard]] vk::PresentModeKHR choose_present_mode() const;
+    void create_swapchain();
+    void create_image_views();
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "thread_pool.hh"
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+    for (uint32_t i = 1; i < thread_count; i++)
+        threads_.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void ThreadPool::run(uint32_t task_count, const void* context, Invoke invoke) {
+    {
+        std::lock_guard lock(mutex_);
+        task_context_ = context;
+        task_invoke_ = invoke;
+        task_count_ = task_count;
+        next_task_.store(0, std::memory_order_relaxed);
+        busy_workers_ = threads_.size();
+        generation_++;
+    }
+    work_available_.notify_all();
+    execute_tasks();
+
+    std::unique_lock lock(mutex_);
+    // Every worker has to see this generation before the next one is published, or it could skip it
+    work_done_.wait(lock, [this] { return busy_workers_ == 0; });
+    task_context_ = nullptr;
+    task_invoke_ = nullptr;
+    if (exception_)
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+}
+
+void ThreadPool::work() {
+    uint64_t generation = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(mutex_);
+            work_available_.wait(lock, [&] { return stopping_ || generation_ != generation; });
+            if (stopping_)
+                return;
+            generation = generation_;
+        }
+        execute_tasks();
+        std::lock_guard lock(mutex_);
+        if (--busy_workers_ == 0)
+            work_done_.notify_one();
+    }
+}
+
+void ThreadPool::execute_tasks() {
+    for (uint32_t i; (i = next_task_.fetch_add(1, std::memory_order_relaxed)) < task_count_;) {
+        try {
+            task_invoke_(task_context_, i);
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!exception_)
+                exception_ = std::current_exception();
+        }
+    }
+}
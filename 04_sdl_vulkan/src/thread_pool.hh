@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_HH_
+#define THREAD_POOL_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fork-join pool. run() hands out task indices to the workers and to the calling thread, and returns once every task
+// completed. Dispatching doesn't allocate, tasks are passed by reference.
+class ThreadPool {
+public:
+    // thread_count includes the calling thread, so thread_count - 1 workers are started
+    explicit ThreadPool(uint32_t thread_count);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    [[nodiscard]] uint32_t get_thread_count() const { return threads_.size() + 1; }
+    // Calls task(i) once for each i in [0, task_count). Each index runs on a single thread, but which thread isn't
+    // specified. Rethrows the first exception thrown by a task.
+    template <typename Task>
+    void run(uint32_t task_count, const Task& task) {
+        run(task_count, &task, [](const void* context, uint32_t index) { (*static_cast<const Task*>(context))(index); });
+    }
+
+private:
+    using Invoke = void (*)(const void* context, uint32_t index);
+
+    void run(uint32_t task_count, const void* context, Invoke invoke);
+    void work();
+    void execute_tasks();
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable work_done_;
+    const void* task_context_ = nullptr;
+    Invoke task_invoke_ = nullptr;
+    uint32_t task_count_ = 0;
+    std::atomic<uint32_t> next_task_{0};
+    uint64_t generation_ = 0;
+    size_t busy_workers_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr exception_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "uniform_ring.hh"
+
+#include <cstring>
+
+namespace {
+vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+UniformRing::UniformRing(MemoryAllocator& allocator, vk::DeviceSize region_size, uint32_t region_count, vk::DeviceSize offset_alignment) :
+    alignment_(offset_alignment),
+    // Every region starts at an offset usable as a dynamic offset
+    region_size_(align_up(region_size, offset_alignment)),
+    region_count_(region_count),
+    buffer_(allocator.create_buffer(region_size_ * region_count, vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)) {}
+
+void UniformRing::begin(uint32_t region) {
+    region_begin_ = region * region_size_;
+    offset_ = 0;
+}
+
+std::optional<uint32_t> UniformRing::push(const void* data, vk::DeviceSize size) {
+    const auto offset = align_up(offset_, alignment_);
+    if (offset + size > region_size_)
+        return std::nullopt;
+    offset_ = offset + size;
+    std::memcpy(static_cast<char*>(buffer_.allocation->mapped) + region_begin_ + offset, data, size);
+    return static_cast<uint32_t>(region_begin_ + offset);
+}
@@ -0,0 +1,39 @@
+#ifndef UNIFORM_RING_HH_
+#define UNIFORM_RING_HH_
+
+#include <cstdint>
+#include <optional>
+
+#include "memory_allocator.hh"
+
+// Persistently mapped, host coherent uniform buffer split into one region per frame that may be in flight. A frame writes
+// its uniforms into its own region and shaders read them through a dynamic offset, so a single descriptor covers the whole
+// ring and nothing is mapped, allocated or rewritten per frame or per object. Not thread safe.
+class UniformRing {
+public:
+    // Offsets are aligned to offset_alignment, which must be at least minUniformBufferOffsetAlignment
+    UniformRing(MemoryAllocator& allocator, vk::DeviceSize region_size, uint32_t region_count, vk::DeviceSize offset_alignment);
+
+    // Starts writing at the beginning of region, which the GPU must no longer read
+    void begin(uint32_t region);
+    // Copies size bytes after the previous ones written to the current region. Returns their dynamic offset, or std::nullopt
+    // if the region is full.
+    std::optional<uint32_t> push(const void* data, vk::DeviceSize size);
+    template <typename T>
+    std::optional<uint32_t> push(const T& data) { return push(&data, sizeof(T)); }
+
+    [[nodiscard]] vk::Buffer get_buffer() const { return *buffer_.buffer; }
+    [[nodiscard]] uint32_t get_region_count() const { return region_count_; }
+    // Dynamic offset of the start of region
+    [[nodiscard]] uint32_t get_region_offset(uint32_t region) const { return static_cast<uint32_t>(region * region_size_); }
+
+private:
+    const vk::DeviceSize alignment_;
+    const vk::DeviceSize region_size_;
+    const uint32_t region_count_;
+    Buffer buffer_;
+    vk::DeviceSize region_begin_ = 0;
+    vk::DeviceSize offset_ = 0;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "uploader.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Stages that may read uploaded buffers
+const vk::PipelineStageFlags CONSUMER_STAGES = vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader
+        | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect;
+const vk::AccessFlags CONSUMER_ACCESS = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eUniformRead
+        | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndirectCommandRead;
+}
+
+Uploader::Uploader(MemoryAllocator& memory_allocator, vk::Queue transfer_queue, uint32_t transfer_queue_family_index, vk::Queue graphics_queue,
+        uint32_t graphics_queue_family_index, vk::DeviceSize ring_size) :
+    device_(memory_allocator.get_device()), allocation_callbacks_(memory_allocator.get_allocation_callbacks()), transfer_queue_(transfer_queue), graphics_queue_(graphics_queue),
+    transfer_queue_family_index_(transfer_queue_family_index), graphics_queue_family_index_(graphics_queue_family_index), ring_size_(ring_size),
+    copy_offset_alignment_(std::max<vk::DeviceSize>(memory_allocator.get_physical_device().getProperties().limits.optimalBufferCopyOffsetAlignment, 1)),
+    ring_(memory_allocator.create_buffer(ring_size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)) {
+    if (ring_size_ % copy_offset_alignment_)
+        throw std::invalid_argument("Upload ring size isn't a multiple of optimalBufferCopyOffsetAlignment");
+    transfer_command_pool_ = device_.createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, transfer_queue_family_index_), allocation_callbacks_);
+    if (has_dedicated_transfer_queue())
+        graphics_command_pool_ = device_.createCommandPoolUnique(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, graphics_queue_family_index_), allocation_callbacks_);
+}
+
+Uploader::~Uploader() {
+    wait_idle();
+}
+
+void Uploader::upload(vk::Buffer destination, vk::DeviceSize destination_offset, const void* data, vk::DeviceSize size) {
+    // Uploads larger than the ring are split in chunks
+    const auto chunk_size = ring_size_ / 2;
+    for (vk::DeviceSize done = 0; done < size;) {
+        const auto copy_size = std::min(size - done, chunk_size);
+        const auto position = reserve(copy_size);
+        const auto ring_offset = position % ring_size_;
+        std::memcpy(static_cast<char*>(ring_.allocation->mapped) + ring_offset, static_cast<const char*>(data) + done, copy_size);
+        pending_copies_.push_back({destination, vk::BufferCopy(ring_offset, destination_offset + done, copy_size)});
+        done += copy_size;
+    }
+}
+
+uint64_t Uploader::reserve(vk::DeviceSize size) {
+    // Copy sources must be contiguous, so skip to the start of the ring if the data doesn't fit before its end. The ring size
+    // is a multiple of the alignment, so aligned positions give aligned offsets.
+    auto position = (head_ + copy_offset_alignment_ - 1) / copy_offset_alignment_ * copy_offset_alignment_;
+    if (position % ring_size_ + size > ring_size_)
+        position += ring_size_ - position % ring_size_;
+    while (position + size - tail_ > ring_size_) {
+        if (retire_oldest_batch(false))
+            continue;
+        // The ring is full of copies not submitted yet or still running
+        if (!pending_copies_.empty())
+            flush();
+        if (!retire_oldest_batch(true))
+            throw std::logic_error("Upload ring is full but nothing is in flight");
+    }
+    head_ = position + size;
+    return position;
+}
+
+void Uploader::flush() {
+    if (pending_copies_.empty())
+        return;
+    auto batch = get_free_batch();
+    const vk::CommandBufferBeginInfo begin_info(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+    // With a dedicated transfer queue the barriers release ownership to the graphics queue family, otherwise they only make the data visible
+    const auto dedicated = has_dedicated_transfer_queue();
+    const vk::AccessFlags destination_access = dedicated ? vk::AccessFlags() : CONSUMER_ACCESS;
+    const uint32_t source_family = dedicated ? transfer_queue_family_index_ : VK_QUEUE_FAMILY_IGNORED;
+    const uint32_t destination_family = dedicated ? graphics_queue_family_index_ : VK_QUEUE_FAMILY_IGNORED;
+    std::vector<vk::BufferMemoryBarrier> barriers;
+    barriers.reserve(pending_copies_.size());
+    batch.transfer_command_buffer->begin(begin_info);
+    for (const auto& copy : pending_copies_) {
+        batch.transfer_command_buffer->copyBuffer(*ring_.buffer, copy.destination, 1, &copy.region);
+        barriers.push_back(vk::BufferMemoryBarrier(vk::AccessFlagBits::eTransferWrite, destination_access, source_family, destination_family,
+                copy.destination, copy.region.dstOffset, copy.region.size));
+    }
+    const auto destination_stages = dedicated ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe) : CONSUMER_STAGES;
+    batch.transfer_command_buffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, destination_stages, {}, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+    batch.transfer_command_buffer->end();
+
+    if (dedicated) {
+        const vk::SubmitInfo transfer_submit_info(0, nullptr, nullptr, 1, &*batch.transfer_command_buffer, 1, &*batch.transfer_finished);
+        transfer_queue_.submit(transfer_submit_info, nullptr);
+
+        for (auto& barrier : barriers) {
+            barrier.srcAccessMask = vk::AccessFlags();
+            barrier.dstAccessMask = CONSUMER_ACCESS;
+        }
+        batch.acquire_command_buffer->begin(begin_info);
+        // Waiting on the semaphore at the barrier's source stages chains the acquire after the release
+        batch.acquire_command_buffer->pipelineBarrier(CONSUMER_STAGES, CONSUMER_STAGES, {}, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+        batch.acquire_command_buffer->end();
+        const vk::PipelineStageFlags wait_stage = CONSUMER_STAGES;
+        const vk::SubmitInfo acquire_submit_info(1, &*batch.transfer_finished, &wait_stage, 1, &*batch.acquire_command_buffer, 0, nullptr);
+        graphics_queue_.submit(acquire_submit_info, *batch.fence);
+    } else {
+        const vk::SubmitInfo submit_info(0, nullptr, nullptr, 1, &*batch.transfer_command_buffer, 0, nullptr);
+        graphics_queue_.submit(submit_info, *batch.fence);
+    }
+
+    pending_copies_.clear();
+    batch.end = head_;
+    batches_in_flight_.push_back(std::move(batch));
+}
+
+void Uploader::wait_idle() {
+    flush();
+    while (retire_oldest_batch(true)) {}
+}
+
+bool Uploader::retire_oldest_batch(bool wait) {
+    if (batches_in_flight_.empty())
+        return false;
+    auto& batch = batches_in_flight_.front();
+    const auto timeout = wait ? std::numeric_limits<uint64_t>::max() : 0;
+    const auto result = device_.waitForFences(1, &*batch.fence, true, timeout);
+    if (result == vk::Result::eTimeout)
+        return false;
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to wait for upload fence");
+    tail_ = batch.end;
+    free_batches_.push_back(std::move(batch));
+    batches_in_flight_.pop_front();
+    return true;
+}
+
+Uploader::Batch Uploader::get_free_batch() {
+    if (!free_batches_.empty()) {
+        auto batch = std::move(free_batches_.back());
+        free_batches_.pop_back();
+        device_.resetFences(*batch.fence);
+        return batch;
+    }
+    Batch batch;
+    batch.transfer_command_buffer = std::move(device_.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(*transfer_command_pool_, vk::CommandBufferLevel::ePrimary, 1))[0]);
+    if (has_dedicated_transfer_queue()) {
+        batch.acquire_command_buffer = std::move(device_.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo(*graphics_command_pool_, vk::CommandBufferLevel::ePrimary, 1))[0]);
+        batch.transfer_finished = device_.createSemaphoreUnique(vk::SemaphoreCreateInfo(), allocation_callbacks_);
+    }
+    batch.fence = device_.createFenceUnique(vk::FenceCreateInfo(), allocation_callbacks_);
+    return batch;
+}
@@ -0,0 +1,64 @@
+#ifndef UPLOADER_HH_
+#define UPLOADER_HH_
+
+#include <deque>
+#include <vector>
+
+#include "memory_allocator.hh"
+
+// Copies data into device local buffers through a persistently mapped staging ring. All copies queued between two calls to
+// flush() go into a single submission on the transfer queue, after which ownership is handed to the graphics queue. Buffers
+// are usable by any graphics submission made after flush() returns, without waiting on the CPU.
+class Uploader {
+public:
+    Uploader(MemoryAllocator& memory_allocator, vk::Queue transfer_queue, uint32_t transfer_queue_family_index, vk::Queue graphics_queue,
+            uint32_t graphics_queue_family_index, vk::DeviceSize ring_size);
+    Uploader(const Uploader&) = delete;
+    Uploader& operator=(const Uploader&) = delete;
+    ~Uploader();
+
+    // Only blocks if the ring is full of copies the GPU hasn't executed yet
+    void upload(vk::Buffer destination, vk::DeviceSize destination_offset, const void* data, vk::DeviceSize size);
+    void flush();
+    // Blocks until every flushed copy completed
+    void wait_idle();
+    [[nodiscard]] bool has_dedicated_transfer_queue() const { return transfer_queue_family_index_ != graphics_queue_family_index_; }
+
+private:
+    struct Copy {
+        vk::Buffer destination;
+        vk::BufferCopy region;
+    };
+
+    struct Batch {
+        vk::UniqueCommandBuffer transfer_command_buffer;
+        // Acquires ownership on the graphics queue, only used with a dedicated transfer queue
+        vk::UniqueCommandBuffer acquire_command_buffer;
+        vk::UniqueSemaphore transfer_finished;
+        vk::UniqueFence fence;
+        // Ring position after the batch's data
+        uint64_t end;
+    };
+
+    const vk::Device device_;
+    const vk::AllocationCallbacks* const allocation_callbacks_;
+    const vk::Queue transfer_queue_, graphics_queue_;
+    const uint32_t transfer_queue_family_index_, graphics_queue_family_index_;
+    const vk::DeviceSize ring_size_;
+    // optimalBufferCopyOffsetAlignment, a power of two
+    const vk::DeviceSize copy_offset_alignment_;
+    Buffer ring_;
+    vk::UniqueCommandPool transfer_command_pool_, graphics_command_pool_;
+    // Positions increase monotonically, the ring offset is position % ring_size_
+    uint64_t head_ = 0, tail_ = 0;
+    std::vector<Copy> pending_copies_;
+    std::deque<Batch> batches_in_flight_;
+    std::vector<Batch> free_batches_;
+
+    uint64_t reserve(vk::DeviceSize size);
+    // Returns false if there was nothing to retire or the oldest batch is still running and wait is false
+    bool retire_oldest_batch(bool wait);
+    Batch get_free_batch();
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef VERTEX_LAYOUT_HH_
+#define VERTEX_LAYOUT_HH_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+enum class ComponentType {
+    floating,
+    signed_integer,
+    unsigned_integer,
+};
+
+struct FormatInfo {
+    uint32_t size;
+    uint32_t component_count;
+    // Type the shader reads, normalized integers are read as floats
+    ComponentType component_type;
+    // Attribute offsets should be aligned to it
+    uint32_t component_size;
+};
+
+// Vertex formats used by attributes. Throwing makes unsupported formats a compile error in constant expressions.
+constexpr FormatInfo get_format_info(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR32Sfloat:
+        return {4, 1, ComponentType::floating, 4};
+    case vk::Format::eR32G32Sfloat:
+        return {8, 2, ComponentType::floating, 4};
+    case vk::Format::eR32G32B32Sfloat:
+        return {12, 3, ComponentType::floating, 4};
+    case vk::Format::eR32G32B32A32Sfloat:
+        return {16, 4, ComponentType::floating, 4};
+    case vk::Format::eR32Uint:
+        return {4, 1, ComponentType::unsigned_integer, 4};
+    case vk::Format::eR32Sint:
+        return {4, 1, ComponentType::signed_integer, 4};
+    case vk::Format::eR16G16Sfloat:
+    case vk::Format::eR16G16Snorm:
+        return {4, 2, ComponentType::floating, 2};
+    case vk::Format::eR8G8B8A8Unorm:
+        return {4, 4, ComponentType::floating, 1};
+    default:
+        throw std::invalid_argument("Unsupported vertex format");
+    }
+}
+
+// Format of a vertex field of type T, specialized for each supported type
+template <typename T>
+constexpr vk::Format vertex_format = vk::Format::eUndefined;
+template <>
+constexpr vk::Format vertex_format<float> = vk::Format::eR32Sfloat;
+template <>
+constexpr vk::Format vertex_format<glm::vec2> = vk::Format::eR32G32Sfloat;
+template <>
+constexpr vk::Format vertex_format<glm::vec3> = vk::Format::eR32G32B32Sfloat;
+template <>
+constexpr vk::Format vertex_format<glm::vec4> = vk::Format::eR32G32B32A32Sfloat;
+template <>
+constexpr vk::Format vertex_format<uint32_t> = vk::Format::eR32Uint;
+template <>
+constexpr vk::Format vertex_format<int32_t> = vk::Format::eR32Sint;
+
+// A field of a vertex struct read by the shader input at location
+struct VertexField {
+    uint32_t location;
+    vk::Format format;
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Declares a field with the format matching its type, or an explicit one whose size must match the field
+#define VERTEX_FIELD(type, member, location) VertexField{location, vertex_format<decltype(type::member)>, offsetof(type, member), sizeof(type::member)}
+#define VERTEX_FIELD_FORMAT(type, member, location, format) VertexField{location, format, offsetof(type, member), sizeof(type::member)}
+
+template <size_t N>
+struct VertexLayout {
+    vk::VertexInputBindingDescription binding;
+    std::array<vk::VertexInputAttributeDescription, N> attributes;
+};
+
+// Builds the binding and attribute descriptions of vertex struct T. Being consteval, every check failing below is a
+// compile error pointing at the failed check.
+template <typename T, size_t N>
+consteval VertexLayout<N> make_vertex_layout(uint32_t binding, vk::VertexInputRate input_rate, const VertexField (&fields)[N]) {
+    VertexLayout<N> layout{vk::VertexInputBindingDescription(binding, sizeof(T), input_rate), {}};
+    for (size_t i = 0; i < N; i++) {
+        const auto& field = fields[i];
+        if (field.format == vk::Format::eUndefined)
+            throw std::invalid_argument("Field type has no vertex format, declare it with VERTEX_FIELD_FORMAT");
+        const auto format_info = get_format_info(field.format);
+        if (format_info.size != field.size)
+            throw std::invalid_argument("Format size differs from the field size");
+        if (field.offset % format_info.component_size)
+            throw std::invalid_argument("Field offset isn't aligned to its components");
+        for (size_t j = 0; j < i; j++) {
+            if (fields[j].location == field.location)
+                throw std::invalid_argument("Two fields use the same location");
+            if (field.offset < fields[j].offset + fields[j].size && fields[j].offset < field.offset + field.size)
+                throw std::invalid_argument("Fields overlap");
+        }
+        layout.attributes[i] = vk::VertexInputAttributeDescription(field.location, binding, field.format, field.offset);
+    }
+    return layout;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "vertex_packing.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Float to half conversion rounding to nearest even, from Fabian Giesen's float_to_half_fast3_rtne
+const uint32_t HALF_OVERFLOW = (127 + 16) << 23;
+const uint32_t HALF_MIN_NORMAL = (127 - 14) << 23;
+const uint32_t HALF_DENORMAL_MAGIC = ((127 - 15) + (23 - 10) + 1) << 23;
+const uint32_t HALF_NORMAL_BIAS = 0xfff - ((127 - 15) << 23);
+const uint32_t FLOAT_INFINITY = 255 << 23;
+
+float fold_octahedral(float value, float other) {
+    return std::copysign(1.f - std::abs(other), value);
+}
+
+#ifdef __SSE2__
+__m128i encode_half(__m128 values) {
+    const auto sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const auto sign = _mm_and_ps(values, sign_mask);
+    const auto absolute = _mm_xor_ps(values, sign);
+    const auto absolute_bits = _mm_castps_si128(absolute);
+    const auto is_nan = _mm_castps_si128(_mm_cmpunord_ps(absolute, absolute));
+    const auto is_finite = _mm_cmpgt_epi32(_mm_set1_epi32(HALF_OVERFLOW), absolute_bits);
+    const auto infinity_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+    const auto is_denormal = _mm_cmpgt_epi32(_mm_set1_epi32(HALF_MIN_NORMAL), absolute_bits);
+
+    const auto denormal_magic = _mm_set1_epi32(HALF_DENORMAL_MAGIC);
+    const auto denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(denormal_magic))), denormal_magic);
+    // -1 if the half's mantissa is odd, in which case ties round up
+    const auto odd = _mm_srai_epi32(_mm_slli_epi32(absolute_bits, 31 - 13), 31);
+    const auto normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absolute_bits, _mm_set1_epi32(HALF_NORMAL_BIAS)), odd), 13);
+
+    const auto finite = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+    const auto magnitude = _mm_or_si128(_mm_and_si128(is_finite, finite), _mm_andnot_si128(is_finite, infinity_or_nan));
+    // Sign extended, so negative halves are in the int16_t range and survive the saturating pack
+    return _mm_or_si128(magnitude, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+__m128i encode_snorm16(__m128 values) {
+    const auto clamped = _mm_min_ps(_mm_max_ps(values, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+    return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(32767.f)));
+}
+
+__m128i encode_unorm8(__m128 values) {
+    const auto clamped = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(255.f)));
+}
+
+__m128 abs(__m128 values) {
+    return _mm_andnot_ps(_mm_castsi128_ps(_mm_set1_epi32(0x80000000)), values);
+}
+
+__m128 fold_octahedral(__m128 values, __m128 others) {
+    const auto sign = _mm_and_ps(values, _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+    return _mm_or_ps(_mm_sub_ps(_mm_set1_ps(1.f), abs(others)), sign);
+}
+#endif
+}
+
+uint16_t encode_half(float value) {
+    auto bits = std::bit_cast<uint32_t>(value);
+    const auto sign = bits & 0x80000000;
+    bits ^= sign;
+    uint32_t result;
+    if (bits >= HALF_OVERFLOW) {
+        result = bits > FLOAT_INFINITY ? 0x7e00 : 0x7c00;
+    } else if (bits < HALF_MIN_NORMAL) {
+        result = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) + std::bit_cast<float>(HALF_DENORMAL_MAGIC)) - HALF_DENORMAL_MAGIC;
+    } else {
+        const auto odd = (bits >> 13) & 1;
+        result = (bits + HALF_NORMAL_BIAS + odd) >> 13;
+    }
+    return static_cast<uint16_t>(result | sign >> 16);
+}
+
+int16_t encode_snorm16(float value) {
+    return static_cast<int16_t>(std::nearbyint(std::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+uint8_t encode_unorm8(float value) {
+    return static_cast<uint8_t>(std::nearbyint(std::clamp(value, 0.f, 1.f) * 255.f));
+}
+
+OctahedralNormal encode_octahedral(glm::vec3 normal) {
+    const auto length = std::max(std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z), FLT_MIN);
+    auto x = normal.x / length;
+    auto y = normal.y / length;
+    if (normal.z < 0)
+        std::tie(x, y) = std::pair(fold_octahedral(x, y), fold_octahedral(y, x));
+    return {encode_snorm16(x), encode_snorm16(y)};
+}
+
+float decode_half(uint16_t value) {
+    const uint32_t sign = value & 0x8000;
+    const uint32_t exponent = value >> 10 & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+    float magnitude;
+    if (!exponent)
+        magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    else if (exponent == 0x1f)
+        magnitude = mantissa ? NAN : INFINITY;
+    else
+        magnitude = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+    return sign ? -magnitude : magnitude;
+}
+
+glm::vec3 decode_octahedral(OctahedralNormal normal) {
+    glm::vec3 result(std::max(normal.x / 32767.f, -1.f), std::max(normal.y / 32767.f, -1.f), 0.f);
+    result.z = 1.f - std::abs(result.x) - std::abs(result.y);
+    if (result.z < 0)
+        std::tie(result.x, result.y) = std::pair(fold_octahedral(result.x, result.y), fold_octahedral(result.y, result.x));
+    return glm::normalize(result);
+}
+
+void encode_half(const float* values, size_t count, uint16_t* result) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 8 <= count; i += 8) {
+        const auto low = encode_half(_mm_loadu_ps(values + i));
+        const auto high = encode_half(_mm_loadu_ps(values + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packs_epi32(low, high));
+    }
+#endif
+    for (; i < count; i++)
+        result[i] = encode_half(values[i]);
+}
+
+void encode_snorm16(const float* values, size_t count, int16_t* result) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 8 <= count; i += 8) {
+        const auto low = encode_snorm16(_mm_loadu_ps(values + i));
+        const auto high = encode_snorm16(_mm_loadu_ps(values + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packs_epi32(low, high));
+    }
+#endif
+    for (; i < count; i++)
+        result[i] = encode_snorm16(values[i]);
+}
+
+void encode_unorm8(const float* values, size_t count, uint8_t* result) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= count; i += 16) {
+        const auto low = _mm_packs_epi32(encode_unorm8(_mm_loadu_ps(values + i)), encode_unorm8(_mm_loadu_ps(values + i + 4)));
+        const auto high = _mm_packs_epi32(encode_unorm8(_mm_loadu_ps(values + i + 8)), encode_unorm8(_mm_loadu_ps(values + i + 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < count; i++)
+        result[i] = encode_unorm8(values[i]);
+}
+
+void encode_octahedral(const glm::vec3* normals, size_t count, OctahedralNormal* result) {
+    size_t i = 0;
+#ifdef __SSE2__
+    static_assert(sizeof(OctahedralNormal) == 2 * sizeof(int16_t));
+    for (; i + 4 <= count; i += 4) {
+        const auto n = normals + i;
+        const auto x = _mm_set_ps(n[3].x, n[2].x, n[1].x, n[0].x);
+        const auto y = _mm_set_ps(n[3].y, n[2].y, n[1].y, n[0].y);
+        const auto z = _mm_set_ps(n[3].z, n[2].z, n[1].z, n[0].z);
+        const auto length = _mm_max_ps(_mm_add_ps(_mm_add_ps(abs(x), abs(y)), abs(z)), _mm_set1_ps(FLT_MIN));
+        const auto projected_x = _mm_div_ps(x, length);
+        const auto projected_y = _mm_div_ps(y, length);
+        const auto lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        const auto encoded_x = _mm_or_ps(_mm_and_ps(lower, fold_octahedral(projected_x, projected_y)), _mm_andnot_ps(lower, projected_x));
+        const auto encoded_y = _mm_or_ps(_mm_and_ps(lower, fold_octahedral(projected_y, projected_x)), _mm_andnot_ps(lower, projected_y));
+        const auto low = encode_snorm16(_mm_unpacklo_ps(encoded_x, encoded_y));
+        const auto high = encode_snorm16(_mm_unpackhi_ps(encoded_x, encoded_y));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packs_epi32(low, high));
+    }
+#endif
+    for (; i < count; i++)
+        result[i] = encode_octahedral(normals[i]);
+}
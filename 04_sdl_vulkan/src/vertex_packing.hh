@@ -0,0 +1,57 @@
+#ifndef VERTEX_PACKING_HH_
+#define VERTEX_PACKING_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "vertex_layout.hh"
+
+// Compact vertex field types, declared with VERTEX_FIELD like float vectors. The shader reads all of them as floats.
+struct Half2 {
+    uint16_t x, y;
+};
+
+// Components in [-1, 1]
+struct Snorm16x2 {
+    int16_t x, y;
+};
+
+// Components in [0, 1]
+struct Unorm8x4 {
+    uint8_t x, y, z, w;
+};
+
+// Unit vector projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one, so it
+// maps to the square [-1, 1]². Decoded in the shader with n = vec3(e, 1 - |e.x| - |e.y|); if (n.z < 0) n.xy = (1 - |n.yx|) * sign(n.xy);
+// followed by a normalization.
+struct OctahedralNormal {
+    int16_t x, y;
+};
+
+template <>
+constexpr vk::Format vertex_format<Half2> = vk::Format::eR16G16Sfloat;
+template <>
+constexpr vk::Format vertex_format<Snorm16x2> = vk::Format::eR16G16Snorm;
+template <>
+constexpr vk::Format vertex_format<Unorm8x4> = vk::Format::eR8G8B8A8Unorm;
+template <>
+constexpr vk::Format vertex_format<OctahedralNormal> = vk::Format::eR16G16Snorm;
+
+// Single values, rounded to nearest even. Out of range values are clamped, to infinity for halves.
+uint16_t encode_half(float value);
+int16_t encode_snorm16(float value);
+uint8_t encode_unorm8(float value);
+OctahedralNormal encode_octahedral(glm::vec3 normal);
+float decode_half(uint16_t value);
+glm::vec3 decode_octahedral(OctahedralNormal normal);
+
+// Bulk encoders for mesh conversion, four values at a time with SSE2 and giving the same results as the single value
+// ones. Vector arrays are passed as their component count, e.g. 2 * n for n glm::vec2.
+void encode_half(const float* values, size_t count, uint16_t* result);
+void encode_snorm16(const float* values, size_t count, int16_t* result);
+void encode_unorm8(const float* values, size_t count, uint8_t* result);
+void encode_octahedral(const glm::vec3* normals, size_t count, OctahedralNormal* result);
+
+#endif
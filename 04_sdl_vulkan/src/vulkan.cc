@@ -1,67 +1,204 @@
 #include"vulkan.hh"
 
+#include "offscreen_target.hh"
+#include "swapchain_target.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <numbers>
 
-#define watch(x) std::cout << #x << " = " << (x) << "\n"
+#include "log.hh"
+#include "mesh.hh"
+#include "mesh_optimizer.hh"
 
 const auto APPLICATION_NAME = "Vulkan demo";
+const size_t PROFILER_CAPACITY = 1 << 16;
+const vk::DeviceSize STAGING_RING_SIZE = 16 << 20;
 const auto SWAPCHAIN_EXTENSION = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
 
 namespace {
-struct Vertex {
-    glm::vec2 pos;
-    glm::vec3 color;
+struct Instance {
+    // Offset in x and y, uniform scale in z and rotation in radians in w
+    glm::vec4 transform;
+    // Multiplied with the vertex colors
+    glm::vec4 color;
+};
 
-    constexpr static auto get_binding_description() {
-        return vk::VertexInputBindingDescription(0, sizeof(Vertex));
-    }
+constexpr auto INSTANCE_LAYOUT = make_vertex_layout<Instance>(1, vk::VertexInputRate::eInstance, {
+        VERTEX_FIELD(Instance, transform, 2),
+        VERTEX_FIELD(Instance, color, 3),
+});
+
+// Specialization constants of shader.frag
+struct FragmentConstants {
+    Shading shading;
 
-    constexpr static auto get_attribute_descriptions() {
-        return std::array<vk::VertexInputAttributeDescription, 2> {
-                vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, pos)),
-                vk::VertexInputAttributeDescription(0, 1, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color)),
-        };
+    constexpr static auto get_map_entries() {
+        return std::array<vk::SpecializationMapEntry, 1> {vk::SpecializationMapEntry(0, offsetof(FragmentConstants, shading), sizeof(Shading))};
     }
 };
 
-const std::vector<Vertex> vertices = {
-        {{0.f, -.5f}, {1.f, 0.f, 0.f}},
-        {{.5f, .5f}, {0.f, 1.f, 0.f}},
-        {{-.5f, .5f}, {0.f, 0.f, 1.f}}
+// Uniform block of shader.vert, std140
+struct FrameUniforms {
+    float rotation;
 };
 
+// Push constants of shader.vert
+struct DrawConstants {
+    // Scale in x and y, offset in z and w
+    glm::vec4 view;
+};
+
+// The scene is drawn in clip space as is
+const DrawConstants SCENE_DRAW_CONSTANTS = {glm::vec4(1.f, 1.f, 0.f, 0.f)};
+
+const vk::PipelineStageFlags WAIT_DST_STAGE_MASK = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+
+// Clip space x and y bounds, objects are placed directly in clip space
+const std::array<glm::vec4, 4> FRUSTUM_PLANES = {{
+    {1.f, 0.f, 0.f, 1.f},
+    {-1.f, 0.f, 0.f, 1.f},
+    {0.f, 1.f, 0.f, 1.f},
+    {0.f, -1.f, 0.f, 1.f},
+}};
+
+// Lays out count instances in a square grid covering [-extent, extent]. A single instance with an extent of 1 reproduces the original triangle.
+std::vector<Instance> generate_instances(uint32_t count, float extent) {
+    const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(count)));
+    const float cell_size = 2.f * extent / side;
+    std::vector<Instance> instances(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const auto column = i % side;
+        const auto row = i / side;
+        const glm::vec2 offset(-extent + (column + .5f) * cell_size, -extent + (row + .5f) * cell_size);
+        const float rotation = count == 1 ? 0.f : i * .618034f;
+        const glm::vec4 color = count == 1 ? glm::vec4(1.f) : glm::vec4(.5f + .5f * std::sin(i * .1f), .5f + .5f * std::sin(i * .13f + 2.f), .5f + .5f * std::sin(i * .17f + 4.f), 1.f);
+        instances[i] = {glm::vec4(offset, cell_size * .5f, rotation), color};
+    }
+    return instances;
+}
+
+// Bounding sphere of each instance, center in xyz and radius in w
+std::vector<glm::vec4> compute_bounds(const std::vector<Instance>& instances, float mesh_radius) {
+    std::vector<glm::vec4> bounds;
+    bounds.reserve(instances.size());
+    for (const auto& instance : instances)
+        bounds.emplace_back(instance.transform.x, instance.transform.y, 0.f, mesh_radius * instance.transform.z);
+    return bounds;
+}
+
+bool device_extension_supported(const vk::PhysicalDevice device, const char* name) {
+    const auto extensions = device.enumerateDeviceExtensionProperties();
+    return std::any_of(std::begin(extensions), std::end(extensions), [name](const vk::ExtensionProperties& extension) { return !std::strcmp(extension.extensionName, name); });
+}
+
+bool instance_extension_supported(const char* name) {
+    const auto extensions = vk::enumerateInstanceExtensionProperties();
+    return std::any_of(std::begin(extensions), std::end(extensions), [name](const vk::ExtensionProperties& extension) { return !std::strcmp(extension.extensionName, name); });
+}
+
+// Instance extensions VK_EXT_swapchain_maintenance1 depends on
+bool surface_maintenance_supported() {
+    return instance_extension_supported(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) && instance_extension_supported(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+}
+
 void print_extensions() {
-    std::cout << "Available extensions:\n";
+    log_debug("Available extensions:");
     for (const auto& extension : vk::enumerateInstanceExtensionProperties())
-        std::cout << "\t" << extension.extensionName << "\n";
+        log_debug("\t", extension.extensionName.data());
 }
 
     bool required_extensions_supported(const vk::PhysicalDevice device) {
-        const auto extensions = device.enumerateDeviceExtensionProperties();
         // For now, check for VK_KHR_SWAPCHAIN_EXTENSION_NAME only
-        return std::any_of(std::begin(extensions), std::end(extensions), [](const vk::ExtensionProperties& extension) { return !std::strcmp(extension.extensionName, SWAPCHAIN_EXTENSION); });
+        return device_extension_supported(device, SWAPCHAIN_EXTENSION);
     }
 }
 
-Vulkan::Vulkan(const std::vector<const char*>& required_extensions, std::function<std::pair<int, int>()>  get_extent, std::function<void()>  wait_window_show_event) :
-    instance_(create_instance(required_extensions)), get_extent_(std::move(get_extent)), wait_window_show_event_(std::move(wait_window_show_event)) {}
+Vulkan::Vulkan(const Options& options, const std::vector<const char*>& required_extensions, std::function<std::pair<int, int>()>  get_extent, std::function<void()>  wait_window_show_event) :
+    options_(options), instance_(create_instance(required_extensions)), get_extent_(std::move(get_extent)), wait_window_show_event_(std::move(wait_window_show_event)),
+    vertex_format_(options.vertex_format) {}
 
     vk::UniqueInstance Vulkan::create_instance(const std::vector<const char*>& required_extensions) {
         print_extensions();
         const vk::ApplicationInfo application_info(APPLICATION_NAME, VK_MAKE_VERSION(1, 2, 0), nullptr, 0, VK_API_VERSION_1_1);
-        const vk::InstanceCreateInfo create_info(vk::InstanceCreateFlags(), &application_info, 0, nullptr, static_cast<uint32_t>(required_extensions.size()), required_extensions.data());
-        return vk::createInstanceUnique(create_info);
+        auto extensions = required_extensions;
+        // Headless rendering doesn't present, windows only use these if the device supports VK_EXT_swapchain_maintenance1 too, see create_logical_device()
+        if (!options_.headless && surface_maintenance_supported()) {
+            for (const auto extension : {VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME}) {
+                if (std::none_of(extensions.begin(), extensions.end(), [extension](const char* name) { return !std::strcmp(name, extension); }))
+                    extensions.push_back(extension);
+            }
+        }
+        const vk::InstanceCreateInfo create_info(vk::InstanceCreateFlags(), &application_info, 0, nullptr, static_cast<uint32_t>(extensions.size()), extensions.data());
+        return vk::createInstanceUnique(create_info, host_allocator_.callbacks());
     }
 
 void Vulkan::initialize(const VkSurfaceKHR surface) {
     surface_ = vk::UniqueSurfaceKHR(surface, *instance_);
     choose_physical_device();
     create_logical_device();
+    memory_allocator_ = std::make_unique<MemoryAllocator>(physical_device_, *device_, host_allocator_.callbacks());
+    render_target_ = std::make_unique<SwapchainTarget>(physical_device_, *device_, *surface_, graphics_queue_family_index_, present_queue_family_index_,
+            present_queue_, get_extent_, wait_window_show_event_, options_.present_policy, options_.swapchain_images, wait_for_present_, present_fences_supported_,
+            host_allocator_.swapchain_callbacks());
+    initialize_device_objects();
+}
+
+void Vulkan::initialize_headless() {
+    choose_physical_device();
+    create_logical_device();
+    memory_allocator_ = std::make_unique<MemoryAllocator>(physical_device_, *device_, host_allocator_.callbacks());
+    render_target_ = std::make_unique<OffscreenTarget>(*memory_allocator_, options_.headless_extent, options_.frames_in_flight + 1, host_allocator_.swapchain_callbacks());
+    initialize_device_objects();
+}
+
+void Vulkan::initialize_device_objects() {
+    if (options_.profile)
+        profiler_ = std::make_unique<Profiler>(PROFILER_CAPACITY);
+    if (!options_.pipeline_cache_path.empty())
+        pipeline_cache_ = std::make_unique<PipelineCache>(physical_device_, *device_, host_allocator_.callbacks(), options_.pipeline_cache_path);
+    uploader_ = std::make_unique<Uploader>(*memory_allocator_, transfer_queue_, transfer_queue_family_index_, graphics_queue_, graphics_queue_family_index_, STAGING_RING_SIZE);
+    log_info(uploader_->has_dedicated_transfer_queue() ? "Uploading through a dedicated transfer queue" : "Uploading through the graphics queue");
+    if (!options_.asset_pack_path.empty())
+        asset_pack_ = std::make_unique<AssetPack>(options_.asset_pack_path);
+    load_shaders();
+    create_scene_buffers();
+    if (draw_mode_ == DrawMode::indirect) {
+        gpu_culling_ = std::make_unique<GpuCulling>(*memory_allocator_, pipeline_cache_ ? pipeline_cache_->get() : vk::PipelineCache(), *bounds_buffer_.buffer,
+                options_.instance_count, index_count_, draw_indirect_count_);
+        log_info("Culling on the GPU, drawing with ", draw_indirect_count_ ? "drawIndexedIndirectCount" : "drawIndexedIndirect");
+    }
+    if (options_.record_threads > 1)
+        record_thread_pool_ = std::make_unique<ThreadPool>(options_.record_threads);
+    const vk::DescriptorSetLayoutBinding uniform_binding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex);
+    frame_descriptor_set_layout_ = device_->createDescriptorSetLayoutUnique(vk::DescriptorSetLayoutCreateInfo({}, 1, &uniform_binding), host_allocator_.callbacks());
+    const vk::PushConstantRange push_constant_range(vk::ShaderStageFlagBits::eVertex, 0, sizeof(DrawConstants));
+    pipeline_layout_ = device_->createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo({}, 1, &*frame_descriptor_set_layout_, 1, &push_constant_range),
+            host_allocator_.callbacks());
+    pipeline_manager_ = std::make_unique<PipelineManager>(*device_, pipeline_cache_ ? pipeline_cache_->get() : vk::PipelineCache(), host_allocator_.callbacks(),
+            options_.pipeline_threads);
     create_command_pool();
-    create_semaphores();
+    create_frame_slots();
+    start_time_ = Profiler::Clock::now();
+
+    recreate_render_target();
+}
 
-    recreate_swapchain();
+Vulkan::~Vulkan() {
+    // Frames may still be in flight, wait for them before destroying the objects they use
+    if (device_)
+        device_->waitIdle();
+    if (pipeline_cache_) {
+        try {
+            pipeline_cache_->save();
+        } catch (const std::exception& e) {
+            log_error("Failed to save pipeline cache: ", e.what());
+        }
+    }
 }
 
 void Vulkan::choose_physical_device() {
@@ -74,10 +211,11 @@ void Vulkan::choose_physical_device() {
 
 bool Vulkan::is_device_suitable(const vk::PhysicalDevice device) {
     const auto properties = device.getProperties();
-    std::cout << "Trying device " << properties.deviceName << "\n";
+    log_info("Trying device ", properties.deviceName.data());
     // auto features = device.getFeatures(); can be used to check for extra features
     std::tie(graphics_queue_family_index_, present_queue_family_index_) = get_graphics_and_present_queue_families(device);
-    return graphics_queue_family_index_ != -1 && present_queue_family_index_ != -1 && required_extensions_supported(device);
+    // Without a surface nothing is presented, so neither present support nor the swapchain extension are needed
+    return graphics_queue_family_index_ != -1 && present_queue_family_index_ != -1 && (!surface_ || required_extensions_supported(device));
 }
 
 std::pair<int, int> Vulkan::get_graphics_and_present_queue_families(const vk::PhysicalDevice device) const {
@@ -86,7 +224,7 @@ std::pair<int, int> Vulkan::get_graphics_and_present_queue_families(const vk::Ph
     uint32_t present_index = -1;
 
     for (unsigned i = 0; i < queue_family_properties.size(); i++) {
-        if (device.getSurfaceSupportKHR(i, *surface_)) {
+        if (!surface_ || device.getSurfaceSupportKHR(i, *surface_)) {
             if (supports_graphics(queue_family_properties[i])) {
                 return {i, i};
             }
@@ -98,95 +236,126 @@ std::pair<int, int> Vulkan::get_graphics_and_present_queue_families(const vk::Ph
     return {graphics_index, present_index};
 }
 
-void Vulkan::create_logical_device() {
-    const float queue_priority = 1.0f;
-    vk::DeviceQueueCreateInfo queue_create_info({}, 0, 1, &queue_priority);
-    const std::array<vk::DeviceQueueCreateInfo, 2> queue_create_infos {
-        vk::DeviceQueueCreateInfo({}, graphics_queue_family_index_, 1, &queue_priority),
-            vk::DeviceQueueCreateInfo({}, present_queue_family_index_, 1, &queue_priority)
-    };
-    const vk::DeviceCreateInfo create_info({}, graphics_queue_family_index_ == present_queue_family_index_ ? 1 : 2, queue_create_infos.data(), 0, nullptr, 1, &SWAPCHAIN_EXTENSION);
-    device_ = physical_device_.createDeviceUnique(create_info);
-    graphics_queue_ = device_->getQueue(graphics_queue_family_index_, 0);
-    present_queue_ = device_->getQueue(present_queue_family_index_, 0);
+uint32_t Vulkan::get_transfer_queue_family(const vk::PhysicalDevice device) const {
+    // Families with transfer but without graphics or compute are usually backed by DMA engines that copy alongside rendering
+    const auto queue_family_properties = device.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < queue_family_properties.size(); i++) {
+        const auto flags = queue_family_properties[i].queueFlags;
+        if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+            return i;
+    }
+    return graphics_queue_family_index_;
 }
 
-void Vulkan::recreate_swapchain() {
-    device_->waitIdle();
-    create_swapchain();
-    create_image_views();
-    create_render_pass();
-    create_pipeline();
-    create_framebuffers();
-    create_command_buffers();
-}
+void Vulkan::create_logical_device() {
+    transfer_queue_family_index_ = get_transfer_queue_family(physical_device_);
+    const float queue_priority = 1.0f;
+    std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
+    for (const auto family : {static_cast<uint32_t>(graphics_queue_family_index_), static_cast<uint32_t>(present_queue_family_index_), transfer_queue_family_index_}) {
+        if (std::none_of(queue_create_infos.begin(), queue_create_infos.end(), [family](const vk::DeviceQueueCreateInfo& info) { return info.queueFamilyIndex == family; }))
+            queue_create_infos.emplace_back(vk::DeviceQueueCreateFlags(), family, 1, &queue_priority);
+    }
 
-vk::SurfaceCapabilitiesKHR Vulkan::update_surface_capabilities() {
-    for (;;) {
-        auto capabilities = physical_device_.getSurfaceCapabilitiesKHR(*surface_);
-        // "currentExtent is the current width and height of the surface, or the special value (0xFFFFFFFF, 0xFFFFFFFF) indicating
-        // that the surface size will be determined by the extent of a swapchain targeting the surface"
-        if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max() || capabilities.currentExtent.height != std::numeric_limits<uint32_t>::max()) {
-            surface_extent_ = capabilities.currentExtent;
+    std::vector<const char*> extensions;
+    if (surface_)
+        extensions.push_back(SWAPCHAIN_EXTENSION);
+    vk::PhysicalDeviceFeatures features;
+    bool enable_draw_indirect_count = false;
+    draw_mode_ = options_.draw_mode;
+    if (draw_mode_ == DrawMode::indirect) {
+        const auto supported_features = physical_device_.getFeatures();
+        if (supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance
+                && physical_device_.getProperties().limits.maxDrawIndirectCount >= options_.instance_count) {
+            features.multiDrawIndirect = true;
+            features.drawIndirectFirstInstance = true;
+            enable_draw_indirect_count = device_extension_supported(physical_device_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            if (enable_draw_indirect_count)
+                extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
         } else {
-            std::tie(surface_extent_.width, surface_extent_.height) = get_extent_();
-            surface_extent_.width = std::clamp(surface_extent_.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-            surface_extent_.height = std::clamp(surface_extent_.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+            log_warning("Indirect drawing of ", options_.instance_count, " objects is not supported, falling back to instanced drawing");
+            draw_mode_ = DrawMode::instanced;
         }
-        // "On some platforms, it is normal that maxImageExtent may become (0, 0), for example when the window is minimized.
-        // In such a case, it is not possible to create a swapchain due to the Valid Usage requirements."
-        if (surface_extent_.width && surface_extent_.height)
-            return capabilities;
-        wait_window_show_event_();
     }
-}
-
-void Vulkan::create_swapchain() {
-    const auto capabilities = update_surface_capabilities();
-    uint32_t image_count = capabilities.minImageCount + 1;
-    if (capabilities.maxImageCount && image_count > capabilities.maxImageCount) {
-        image_count = capabilities.maxImageCount;
+    // Present latency is measured with VK_KHR_present_wait, which needs Vulkan 1.1 to query its features
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_features;
+    vk::PhysicalDevicePresentIdFeaturesKHR present_id_features;
+    if (surface_ && options_.profile && physical_device_.getProperties().apiVersion >= VK_API_VERSION_1_1
+            && device_extension_supported(physical_device_, VK_KHR_PRESENT_ID_EXTENSION_NAME) && device_extension_supported(physical_device_, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        const auto supported_features = physical_device_.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        if (supported_features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId && supported_features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait) {
+            present_id_features.presentId = true;
+            present_id_features.pNext = &present_wait_features;
+            present_wait_features.presentWait = true;
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
     }
-
-    const auto formats = physical_device_.getSurfaceFormatsKHR(*surface_);
-    vk::SurfaceFormatKHR chosen_format = formats[0];
-    for (const auto& format : formats) {
-        // TODO check for other sRGB colorspaces? One of them must be available:
-        // "Vulkan requires that all implementations support the sRGB transfer function by use of an SRGB pixel format"
-        if (format.format == vk::Format::eB8G8R8Unorm && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
-            chosen_format = format;
-            break;
+    // Present fences tell when the presentations of an old swapchain completed, so recreating it doesn't idle the present queue
+    vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchain_maintenance_features;
+    if (surface_ && physical_device_.getProperties().apiVersion >= VK_API_VERSION_1_1 && surface_maintenance_supported()
+            && device_extension_supported(physical_device_, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)) {
+        const auto supported_features = physical_device_.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>();
+        if (supported_features.get<vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>().swapchainMaintenance1) {
+            swapchain_maintenance_features.swapchainMaintenance1 = true;
+            extensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
         }
     }
-    swapchain_format_ = chosen_format.format;
-
-    vk::SwapchainCreateInfoKHR create_info(vk::SwapchainCreateFlagsKHR(), *surface_, image_count, chosen_format.format, chosen_format.colorSpace, surface_extent_, 1,
-            vk::ImageUsageFlagBits::eColorAttachment, vk::SharingMode::eExclusive, 0, nullptr, capabilities.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque,
-            vk::PresentModeKHR::eFifo, true);
-    std::array<uint32_t, 2> queue_family_indices;
-    if (graphics_queue_family_index_ != present_queue_family_index_) {
-        queue_family_indices = {static_cast<uint32_t>(graphics_queue_family_index_), static_cast<uint32_t>(present_queue_family_index_)};
-        create_info.imageSharingMode = vk::SharingMode::eConcurrent;
-        create_info.queueFamilyIndexCount = 2;
-        create_info.pQueueFamilyIndices = queue_family_indices.data();
+    vk::DeviceCreateInfo create_info({}, queue_create_infos.size(), queue_create_infos.data(), 0, nullptr, extensions.size(), extensions.data(), &features);
+    if (present_wait_features.presentWait)
+        create_info.pNext = &present_id_features;
+    if (swapchain_maintenance_features.swapchainMaintenance1) {
+        swapchain_maintenance_features.pNext = const_cast<void*>(create_info.pNext);
+        create_info.pNext = &swapchain_maintenance_features;
     }
-    swapchain_ = device_->createSwapchainKHRUnique(create_info);
-
-    swapchain_images_ = device_->getSwapchainImagesKHR(*swapchain_);
+    present_fences_supported_ = swapchain_maintenance_features.swapchainMaintenance1;
+    device_ = physical_device_.createDeviceUnique(create_info, host_allocator_.callbacks());
+    if (present_wait_features.presentWait)
+        wait_for_present_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(device_->getProcAddr("vkWaitForPresentKHR"));
+    else if (surface_ && options_.profile)
+        log_warning("VK_KHR_present_wait is unsupported, present latency won't be measured");
+    if (enable_draw_indirect_count)
+        draw_indirect_count_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(device_->getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+    graphics_queue_ = device_->getQueue(graphics_queue_family_index_, 0);
+    present_queue_ = device_->getQueue(present_queue_family_index_, 0);
+    transfer_queue_ = device_->getQueue(transfer_queue_family_index_, 0);
 }
 
-void Vulkan::create_image_views() {
-    swapchain_image_views_.resize(swapchain_images_.size());
-    for (unsigned i = 0; i < swapchain_images_.size(); i++) {
-        const vk::ImageViewCreateInfo create_info(vk::ImageViewCreateFlags(), swapchain_images_[i], vk::ImageViewType::e2D, swapchain_format_,
-                vk::ComponentMapping(), vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
-        swapchain_image_views_[i] = device_->createImageViewUnique(create_info);
+void Vulkan::recreate_render_target() {
+    // Only the frames that may still use the old images and command buffers need to finish, the device can stay busy
+    std::vector<vk::Fence> fences;
+    for (const auto& frame : frames_)
+        fences.push_back(*frame.in_flight_fence);
+    if (device_->waitForFences(fences, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to wait for frame fences");
+
+    render_target_->recreate();
+    // Presentations of the old images completed during the recreation, so their semaphores can go
+    render_finished_semaphores_.clear();
+    if (render_target_->uses_semaphores()) {
+        for (size_t i = 0; i < render_target_->image_views().size(); i++)
+            render_finished_semaphores_.push_back(device_->createSemaphoreUnique(vk::SemaphoreCreateInfo(), host_allocator_.swapchain_callbacks()));
+    }
+    // The pipeline uses dynamic viewport and scissor, so it only depends on the render pass, which depends on the format
+    if (!render_pass_ || render_target_->format() != render_pass_format_) {
+        // Compilations in progress use the old render pass
+        pipeline_manager_->clear();
+        create_render_pass();
+        request_pipeline();
+        // The scene has no fallback and nothing asks for a redraw once it compiles, so a window rendering on demand would
+        // stay empty. Later variants still compile in the background.
+        pipeline_manager_->wait_idle();
     }
+    create_framebuffers();
+    create_timestamp_query_pool();
+    if (gpu_culling_)
+        gpu_culling_->resize(render_target_->image_views().size());
+    create_command_buffers();
+    images_in_flight_.assign(render_target_->image_views().size(), nullptr);
 }
 
 void Vulkan::create_render_pass() {
-    const vk::AttachmentDescription color_attachment_description(vk::AttachmentDescriptionFlags(), swapchain_format_, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore,
-            vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR);
+    const vk::AttachmentDescription color_attachment_description(vk::AttachmentDescriptionFlags(), render_target_->format(), vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eLoad, vk::AttachmentStoreOp::eStore,
+            vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, render_target_->final_layout());
 
     const vk::AttachmentReference color_attachment_reference(0, vk::ImageLayout::eColorAttachmentOptimal);
     const vk::SubpassDescription subpass(vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, 0, nullptr, 1, &color_attachment_reference);
@@ -194,12 +363,8 @@ void Vulkan::create_render_pass() {
     const vk::SubpassDependency dependency(VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlags(), vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
 
     const vk::RenderPassCreateInfo create_info(vk::RenderPassCreateFlags(), 1, &color_attachment_description, 1, &subpass, 1, &dependency);
-    render_pass_ = device_->createRenderPassUnique(create_info);
-}
-
-vk::UniqueShaderModule Vulkan::create_shader_module(const uint32_t *spirv, size_t code_size) {
-    const vk::ShaderModuleCreateInfo create_info(vk::ShaderModuleCreateFlags(), code_size, spirv);
-    return device_->createShaderModuleUnique(create_info);
+    render_pass_ = device_->createRenderPassUnique(create_info, host_allocator_.callbacks());
+    render_pass_format_ = render_target_->format();
 }
 
 // TODO remove hardcoded shaders
@@ -208,95 +373,432 @@ vk::UniqueShaderModule Vulkan::create_shader_module(const uint32_t *spirv, size_
 #include "shader.frag.h"
 #include "shader.vert.h"
 
-void Vulkan::create_pipeline() {
-    const auto vertex_shader = create_shader_module(shader_vert_spirv, sizeof(shader_vert_spirv));
-    const auto fragment_shader = create_shader_module(shader_frag_spirv, sizeof(shader_frag_spirv));
+void Vulkan::load_shaders() {
+    if (!asset_pack_) {
+        vertex_shader_ = shader_vert_spirv;
+        fragment_shader_ = shader_frag_spirv;
+        return;
+    }
+    const auto load = [this](const char* name) {
+        const auto asset = asset_pack_->get(name, AssetType::spirv);
+        if (asset.size != asset.count * sizeof(uint32_t))
+            throw std::runtime_error(std::string("Invalid SPIR-V size of ") + name + " in " + asset_pack_->get_path());
+        // Blobs are aligned in the mapping
+        return std::span(reinterpret_cast<const uint32_t*>(asset.data), asset.count);
+    };
+    vertex_shader_ = load(VERTEX_SHADER_ASSET);
+    fragment_shader_ = load(FRAGMENT_SHADER_ASSET);
+}
 
-    vk::PipelineShaderStageCreateInfo vertex_create_info({}, vk::ShaderStageFlagBits::eVertex, *vertex_shader, "main");
-    vk::PipelineShaderStageCreateInfo fragment_create_info({}, vk::ShaderStageFlagBits::eFragment, *fragment_shader, "main");
-    vk::PipelineShaderStageCreateInfo stages_create_info[] = {vertex_create_info, fragment_create_info};
+void Vulkan::request_pipeline() {
+    PipelineKey key;
+    key.vertex_shader = vertex_shader_.data();
+    key.vertex_shader_size = vertex_shader_.size_bytes();
+    key.fragment_shader = fragment_shader_.data();
+    key.fragment_shader_size = fragment_shader_.size_bytes();
+    key.fragment_specialization = SpecializationConstants::from(FragmentConstants{options_.shading});
+    const auto& vertex_layout = get_vertex_layout(vertex_format_);
+    key.bindings = {vertex_layout.binding, INSTANCE_LAYOUT.binding};
+    key.binding_count = 2;
+    std::copy(vertex_layout.attributes.begin(), vertex_layout.attributes.end(), key.attributes.begin());
+    std::copy(INSTANCE_LAYOUT.attributes.begin(), INSTANCE_LAYOUT.attributes.end(), key.attributes.begin() + vertex_layout.attributes.size());
+    key.attribute_count = vertex_layout.attributes.size() + INSTANCE_LAYOUT.attributes.size();
+    key.layout = *pipeline_layout_;
+    key.render_pass = *render_pass_;
+    // Compiled in the background, draws are skipped until it is ready
+    graphics_pipeline_ = pipeline_manager_->request(key);
+}
 
-    const auto binding_description = Vertex::get_binding_description();
-    const auto attribute_descriptions = Vertex::get_attribute_descriptions();
-    vk::PipelineVertexInputStateCreateInfo vertex_input_info({}, 1, &binding_description, attribute_descriptions.size(), attribute_descriptions.data());
+void Vulkan::create_framebuffers() {
+    const auto& image_views = render_target_->image_views();
+    const auto extent = render_target_->extent();
+    frame_buffers_.resize(image_views.size());
+    for (size_t i = 0; i < frame_buffers_.size(); i++) {
+        const vk::FramebufferCreateInfo framebuffer_create_info({}, *render_pass_, 1, &*image_views[i], extent.width, extent.height, 1);
+        frame_buffers_[i] = device_->createFramebufferUnique(framebuffer_create_info, host_allocator_.swapchain_callbacks());
+    }
+}
 
-    vk::PipelineInputAssemblyStateCreateInfo input_assembly({}, vk::PrimitiveTopology::eTriangleList);
+void Vulkan::create_scene_buffers() {
+    // Generated meshes are kept alive until uploaded, packed ones are copied from the mapping to the staging ring
+    Mesh mesh;
+    std::vector<std::byte> encoded_vertices;
+    const void* vertices;
+    const void* indices;
+    float mesh_radius;
+    if (asset_pack_) {
+        const auto vertex_asset = asset_pack_->get(MESH_VERTICES_ASSET, AssetType::vertices);
+        const auto index_asset = asset_pack_->get(MESH_INDICES_ASSET, AssetType::indices);
+        const auto bounds_asset = asset_pack_->get(MESH_BOUNDS_ASSET, AssetType::bounds);
+        if (vertex_asset.format > static_cast<uint32_t>(VertexFormat::snorm16)
+                || vertex_asset.size != uint64_t(vertex_asset.count) * get_vertex_layout(static_cast<VertexFormat>(vertex_asset.format)).binding.stride
+                || index_asset.format != sizeof(uint16_t) || index_asset.size != uint64_t(index_asset.count) * sizeof(uint16_t) || bounds_asset.size != sizeof(glm::vec4)
+                || !vertex_asset.count || !index_asset.count || index_asset.count % 3)
+            throw std::runtime_error("Unsupported mesh in asset pack " + asset_pack_->get_path());
+        // Checksums only catch corruption, indices the packer got wrong must not make the GPU fetch out of bounds. Assets
+        // are 64-byte aligned, so the indices can be read in place.
+        if (!indices_in_range(std::span(reinterpret_cast<const uint16_t*>(index_asset.data), index_asset.count), vertex_asset.count))
+            throw std::runtime_error("Unsupported mesh in asset pack " + asset_pack_->get_path());
+        vertex_format_ = static_cast<VertexFormat>(vertex_asset.format);
+        vertices = vertex_asset.data;
+        vertex_count_ = vertex_asset.count;
+        indices = index_asset.data;
+        index_count_ = index_asset.count;
+        glm::vec4 bounds;
+        std::memcpy(&bounds, bounds_asset.data, sizeof(bounds));
+        mesh_radius = glm::length(glm::vec3(bounds)) + bounds.w;
+    } else {
+        mesh = generate_mesh(options_.mesh_subdivisions);
+        if (options_.optimize_mesh) {
+            const auto statistics = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+            optimize_mesh(mesh);
+            log_info("Mesh optimized from an ACMR of ", statistics.acmr, " and ATVR of ", statistics.atvr);
+        }
+        encoded_vertices = encode_vertices(mesh.vertices, vertex_format_);
+        vertices = encoded_vertices.data();
+        vertex_count_ = mesh.vertices.size();
+        indices = mesh.indices.data();
+        index_count_ = mesh.indices.size();
+        mesh_radius = compute_radius(mesh.vertices);
+    }
 
-    vk::Viewport viewport(0., 0., surface_extent_.width, surface_extent_.height, 0., 1.);
-    vk::Rect2D scissor({}, surface_extent_);
-    vk::PipelineViewportStateCreateInfo viewport_state({}, 1, &viewport, 1, &scissor);
-    vk::PipelineRasterizationStateCreateInfo rasterizer({}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eClockwise, false, {}, {}, {}, 1.);
-    vk::PipelineMultisampleStateCreateInfo multisampling({}, vk::SampleCountFlagBits::e1, false);
-    vk::PipelineColorBlendAttachmentState color_blend_attachment(false, {}, {}, {}, {}, {}, {}, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-    vk::PipelineColorBlendStateCreateInfo color_blend_create_info({}, {}, vk::LogicOp::eClear, 1, &color_blend_attachment);
+    const auto vertices_size = vk::DeviceSize(vertex_count_) * get_vertex_size();
+    vertex_buffer_ = memory_allocator_->create_buffer(vertices_size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    uploader_->upload(*vertex_buffer_.buffer, 0, vertices, vertices_size);
+    const auto statistics = analyze_vertex_cache(std::span(static_cast<const uint16_t*>(indices), index_count_), vertex_count_);
+    log_info("Mesh of ", vertex_count_, " vertices and ", index_count_ / 3, " triangles, ", get_vertex_size(), " bytes per vertex, ACMR ", statistics.acmr,
+            " and ATVR ", statistics.atvr, " with a ", VERTEX_CACHE_SIZE, " entry vertex cache");
+
+    const auto indices_size = vk::DeviceSize(index_count_) * sizeof(uint16_t);
+    index_buffer_ = memory_allocator_->create_buffer(indices_size, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    uploader_->upload(*index_buffer_.buffer, 0, indices, indices_size);
+
+    const auto instances = generate_instances(options_.instance_count, options_.scene_scale);
+    const auto instances_size = instances.size() * sizeof(Instance);
+    instance_buffer_ = memory_allocator_->create_buffer(instances_size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    uploader_->upload(*instance_buffer_.buffer, 0, instances.data(), instances_size);
+
+    if (draw_mode_ == DrawMode::indirect) {
+        const auto bounds = compute_bounds(instances, mesh_radius);
+        const auto bounds_size = bounds.size() * sizeof(glm::vec4);
+        bounds_buffer_ = memory_allocator_->create_buffer(bounds_size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        uploader_->upload(*bounds_buffer_.buffer, 0, bounds.data(), bounds_size);
+    }
+    uploader_->flush();
+}
 
-    vk::PipelineLayoutCreateInfo pipeline_layout_info;
-    pipeline_layout_ = device_->createPipelineLayoutUnique(pipeline_layout_info);
+uint32_t Vulkan::get_vertex_size() const {
+    return get_vertex_layout(vertex_format_).binding.stride;
+}
 
-    vk::GraphicsPipelineCreateInfo pipeline_create_info({}, 2, stages_create_info, &vertex_input_info, &input_assembly, {}, &viewport_state, &rasterizer, &multisampling, {}, &color_blend_create_info, {}, *pipeline_layout_, *render_pass_);
-    auto pipeline_result_value = device_->createGraphicsPipelinesUnique(nullptr, std::move(pipeline_create_info));
-    if (pipeline_result_value.result != vk::Result::eSuccess) {
-        // TODO proper error handling
-        throw std::runtime_error("Failed to create pipeline");
-    }
-    graphics_pipeline_ = std::move(pipeline_result_value.value[0]);
+void Vulkan::wait_for_pipelines() {
+    pipeline_manager_->wait_idle();
 }
 
-void Vulkan::create_framebuffers() {
-    swapchain_frame_buffers_.resize(swapchain_image_views_.size());
-    for (size_t i = 0; i < swapchain_frame_buffers_.size(); i++) {
-        const vk::FramebufferCreateInfo framebuffer_create_info({}, *render_pass_, 1, &*swapchain_image_views_[i], surface_extent_.width, surface_extent_.height, 1);
-        swapchain_frame_buffers_[i] = device_->createFramebufferUnique(framebuffer_create_info);
+void Vulkan::benchmark_uploads(vk::DeviceSize total_size) {
+    const vk::DeviceSize chunk_size = 1 << 20;
+    const vk::DeviceSize destination_size = 64 << 20;
+    const auto destination = memory_allocator_->create_buffer(destination_size, vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    const std::vector<char> data(chunk_size, 1);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (vk::DeviceSize uploaded = 0; uploaded < total_size; uploaded += chunk_size) {
+        uploader_->upload(*destination.buffer, uploaded % destination_size, data.data(), chunk_size);
+        // Batch 16 MiB per submission
+        if ((uploaded / chunk_size) % 16 == 15)
+            uploader_->flush();
     }
+    uploader_->wait_idle();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Uploaded " << (total_size >> 20) << " MiB in " << elapsed.count() << " s, " << total_size / elapsed.count() / (1 << 30) << " GiB/s through the "
+              << (uploader_->has_dedicated_transfer_queue() ? "dedicated transfer" : "graphics") << " queue\n";
 }
 
 void Vulkan::create_command_pool() {
-    const vk::CommandPoolCreateInfo command_pool_create_info({}, graphics_queue_family_index_);
-    command_pool_ = device_->createCommandPoolUnique(command_pool_create_info);
+    // Prerecorded command buffers are rerecorded individually when pipelines become ready
+    const vk::CommandPoolCreateInfo command_pool_create_info(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, graphics_queue_family_index_);
+    command_pool_ = device_->createCommandPoolUnique(command_pool_create_info, host_allocator_.callbacks());
+    if (record_thread_pool_) {
+        for (uint32_t i = 0; i < record_thread_pool_->get_thread_count(); i++)
+            secondary_command_pools_.push_back(device_->createCommandPoolUnique(command_pool_create_info, host_allocator_.callbacks()));
+    }
 }
 
 void Vulkan::create_command_buffers() {
-    const vk::CommandBufferAllocateInfo allocate_info(*command_pool_, vk::CommandBufferLevel::ePrimary, swapchain_frame_buffers_.size());
+    command_buffers_.clear();
+    secondary_command_buffers_.clear();
+    if (options_.record_every_frame)
+        return;
+    // Each image's command buffer reads the uniforms from the image's region, through a set that only changes with the ring
+    if (!uniform_ring_ || uniform_ring_->get_region_count() != frame_buffers_.size()) {
+        create_uniform_ring(frame_buffers_.size());
+        if (!descriptor_pool_) {
+            const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eUniformBufferDynamic, 1);
+            descriptor_pool_ = device_->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, 1, 1, &pool_size), host_allocator_.callbacks());
+        }
+        device_->resetDescriptorPool(*descriptor_pool_);
+        descriptor_set_ = allocate_frame_descriptor_set(*descriptor_pool_);
+    }
+    const auto start = Profiler::Clock::now();
+    const vk::CommandBufferAllocateInfo allocate_info(*command_pool_, vk::CommandBufferLevel::ePrimary, frame_buffers_.size());
     command_buffers_ = device_->allocateCommandBuffersUnique(allocate_info);
-    const vk::CommandBufferBeginInfo begin_info(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
-    for (size_t i = 0; i < command_buffers_.size(); i++) {
-        command_buffers_[i]->begin(begin_info);
-
-        vk::ClearValue clear_color(vk::ClearColorValue(std::array<float, 4>{0.f, 0.f, 0.f, 1.f}));
-        vk::RenderPassBeginInfo render_pass_begin_info(*render_pass_, *swapchain_frame_buffers_[i], vk::Rect2D({0, 0}, surface_extent_), 1, &clear_color);
-
-        command_buffers_[i]->beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
-        command_buffers_[i]->bindPipeline(vk::PipelineBindPoint::eGraphics, *graphics_pipeline_);
-        command_buffers_[i]->draw(3, 1, 0, 0);
-        command_buffers_[i]->endRenderPass();
-        command_buffers_[i]->end();
+    secondary_command_buffers_.resize(command_buffers_.size());
+    recorded_pipeline_generations_.assign(command_buffers_.size(), pipeline_manager_->get_generation());
+    for (uint32_t i = 0; i < command_buffers_.size(); i++) {
+        for (const auto& pool : secondary_command_pools_)
+            secondary_command_buffers_[i].push_back(std::move(device_->allocateCommandBuffersUnique({*pool, vk::CommandBufferLevel::eSecondary, 1}).front()));
+        record_command_buffer(*command_buffers_[i], secondary_command_buffers_[i], i, vk::CommandBufferUsageFlagBits::eSimultaneousUse, descriptor_set_,
+                uniform_ring_->get_region_offset(i));
     }
+    log_info("Recorded ", command_buffers_.size(), " command buffers in ", Profiler::elapsed_ms(start, Profiler::Clock::now()), " ms on ",
+            record_thread_pool_ ? record_thread_pool_->get_thread_count() : 1, " threads");
 }
 
-void Vulkan::create_semaphores() {
-    vk::SemaphoreCreateInfo create_info;
-    image_available_semaphore_ = device_->createSemaphoreUnique(create_info);
-    render_finished_semaphore_ = device_->createSemaphoreUnique(create_info);
+void Vulkan::record_command_buffer(vk::CommandBuffer command_buffer, const std::vector<vk::UniqueCommandBuffer>& secondary_command_buffers, uint32_t image_index,
+        vk::CommandBufferUsageFlags usage, vk::DescriptorSet descriptor_set, uint32_t uniform_offset) {
+    const vk::CommandBufferBeginInfo begin_info(usage);
+    command_buffer.begin(begin_info);
+
+    vk::ClearValue clear_color(vk::ClearColorValue(std::array<float, 4>{0.f, 0.f, 0.f, 1.f}));
+    vk::RenderPassBeginInfo render_pass_begin_info(*render_pass_, *frame_buffers_[image_index], vk::Rect2D({0, 0}, render_target_->extent()), 1, &clear_color);
+
+    if (timestamp_query_pool_) {
+        command_buffer.resetQueryPool(*timestamp_query_pool_, 2 * image_index, 2);
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *timestamp_query_pool_, 2 * image_index);
+    }
+    if (gpu_culling_)
+        gpu_culling_->record_culling(command_buffer, image_index, FRUSTUM_PLANES);
+    if (record_thread_pool_) {
+        command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eSecondaryCommandBuffers);
+        const vk::CommandBufferInheritanceInfo inheritance_info(*render_pass_, 0, *frame_buffers_[image_index]);
+        const vk::CommandBufferBeginInfo secondary_begin_info(vk::CommandBufferUsageFlagBits::eRenderPassContinue | usage, &inheritance_info);
+        // Indirect drawing is a single command, there is nothing to split
+        const uint32_t slice_count = draw_mode_ == DrawMode::indirect ? 1 : secondary_command_buffers.size();
+        record_thread_pool_->run(slice_count, [&](uint32_t slice) {
+            const auto secondary_command_buffer = *secondary_command_buffers[slice];
+            const auto first_instance = static_cast<uint32_t>(uint64_t(options_.instance_count) * slice / slice_count);
+            const auto end_instance = static_cast<uint32_t>(uint64_t(options_.instance_count) * (slice + 1) / slice_count);
+            secondary_command_buffer.begin(secondary_begin_info);
+            record_draws(secondary_command_buffer, image_index, descriptor_set, uniform_offset, first_instance, end_instance - first_instance);
+            secondary_command_buffer.end();
+        });
+        std::array<vk::CommandBuffer, MAX_RECORD_THREADS> secondary_command_buffer_handles;
+        for (uint32_t slice = 0; slice < slice_count; slice++)
+            secondary_command_buffer_handles[slice] = *secondary_command_buffers[slice];
+        command_buffer.executeCommands(slice_count, secondary_command_buffer_handles.data());
+    } else {
+        command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+        record_draws(command_buffer, image_index, descriptor_set, uniform_offset, 0, options_.instance_count);
+    }
+    command_buffer.endRenderPass();
+    if (timestamp_query_pool_)
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *timestamp_query_pool_, 2 * image_index + 1);
+    command_buffer.end();
+}
+
+void Vulkan::record_draws(vk::CommandBuffer command_buffer, uint32_t image_index, vk::DescriptorSet descriptor_set, uint32_t uniform_offset, uint32_t first_instance,
+        uint32_t instance_count) const {
+    const auto pipeline = pipeline_manager_->get(graphics_pipeline_);
+    if (!pipeline)
+        return;
+    const auto extent = render_target_->extent();
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    const vk::Viewport viewport(0., 0., extent.width, extent.height, 0., 1.);
+    const vk::Rect2D scissor({}, extent);
+    command_buffer.setViewport(0, 1, &viewport);
+    command_buffer.setScissor(0, 1, &scissor);
+    // Per-object data comes from the instance buffer, so however many objects there are, a frame binds a single set and the
+    // draw constants are pushed once for the draws that follow
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipeline_layout_, 0, 1, &descriptor_set, 1, &uniform_offset);
+    command_buffer.pushConstants(*pipeline_layout_, vk::ShaderStageFlagBits::eVertex, 0, sizeof(DrawConstants), &SCENE_DRAW_CONSTANTS);
+    const std::array<vk::Buffer, 2> vertex_buffers = {*vertex_buffer_.buffer, *instance_buffer_.buffer};
+    const std::array<vk::DeviceSize, 2> vertex_buffer_offsets = {0, 0};
+    command_buffer.bindVertexBuffers(0, vertex_buffers.size(), vertex_buffers.data(), vertex_buffer_offsets.data());
+    command_buffer.bindIndexBuffer(*index_buffer_.buffer, 0, vk::IndexType::eUint16);
+    switch (draw_mode_) {
+    case DrawMode::instanced:
+        command_buffer.drawIndexed(index_count_, instance_count, 0, 0, first_instance);
+        break;
+    case DrawMode::direct:
+        for (uint32_t instance = first_instance; instance < first_instance + instance_count; instance++)
+            command_buffer.drawIndexed(index_count_, 1, 0, 0, instance);
+        break;
+    case DrawMode::indirect:
+        gpu_culling_->record_draw(command_buffer, image_index);
+        break;
+    }
+}
+
+void Vulkan::create_frame_slots() {
+    vk::SemaphoreCreateInfo semaphore_create_info;
+    // Created signaled so the first wait on each slot returns immediately
+    vk::FenceCreateInfo fence_create_info(vk::FenceCreateFlagBits::eSignaled);
+    // Never resized afterwards, the submit infos point into the slots
+    frames_.resize(options_.frames_in_flight);
+    const uint32_t semaphore_count = render_target_->uses_semaphores() ? 1 : 0;
+    const vk::CommandPoolCreateInfo command_pool_create_info(vk::CommandPoolCreateFlagBits::eTransient, graphics_queue_family_index_);
+    const vk::DescriptorPoolSize descriptor_pool_size(vk::DescriptorType::eUniformBufferDynamic, 1);
+    if (options_.record_every_frame)
+        create_uniform_ring(frames_.size());
+    for (auto& frame : frames_) {
+        frame.image_available_semaphore = device_->createSemaphoreUnique(semaphore_create_info, host_allocator_.callbacks());
+        frame.in_flight_fence = device_->createFenceUnique(fence_create_info, host_allocator_.callbacks());
+        frame.submit_info = vk::SubmitInfo(semaphore_count, &*frame.image_available_semaphore, &WAIT_DST_STAGE_MASK, 1, &frame.submitted_command_buffer,
+                semaphore_count, nullptr);
+        if (!options_.record_every_frame)
+            continue;
+        // Buffers are allocated once and only reset along with their pool
+        frame.command_pool = device_->createCommandPoolUnique(command_pool_create_info, host_allocator_.callbacks());
+        frame.command_buffer = std::move(device_->allocateCommandBuffersUnique({*frame.command_pool, vk::CommandBufferLevel::ePrimary, 1}).front());
+        for (size_t i = 0; record_thread_pool_ && i < record_thread_pool_->get_thread_count(); i++) {
+            frame.secondary_command_pools.push_back(device_->createCommandPoolUnique(command_pool_create_info, host_allocator_.callbacks()));
+            frame.secondary_command_buffers.push_back(std::move(device_->allocateCommandBuffersUnique({*frame.secondary_command_pools.back(), vk::CommandBufferLevel::eSecondary, 1}).front()));
+        }
+        frame.descriptor_pool = device_->createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, 1, 1, &descriptor_pool_size), host_allocator_.callbacks());
+    }
+}
+
+void Vulkan::create_uniform_ring(uint32_t region_count) {
+    const auto alignment = physical_device_.getProperties().limits.minUniformBufferOffsetAlignment;
+    uniform_ring_ = std::make_unique<UniformRing>(*memory_allocator_, sizeof(FrameUniforms), region_count, alignment);
+}
+
+vk::DescriptorSet Vulkan::allocate_frame_descriptor_set(vk::DescriptorPool pool) const {
+    const vk::DescriptorSetAllocateInfo allocate_info(pool, 1, &*frame_descriptor_set_layout_);
+    vk::DescriptorSet descriptor_set;
+    if (device_->allocateDescriptorSets(&allocate_info, &descriptor_set) != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to allocate frame descriptor set");
+    // The range is a single frame's uniforms, the dynamic offset selects the region
+    const vk::DescriptorBufferInfo buffer_info(uniform_ring_->get_buffer(), 0, sizeof(FrameUniforms));
+    const vk::WriteDescriptorSet write(descriptor_set, 0, 0, 1, vk::DescriptorType::eUniformBufferDynamic, nullptr, &buffer_info);
+    device_->updateDescriptorSets(1, &write, 0, nullptr);
+    return descriptor_set;
+}
+
+uint32_t Vulkan::write_frame_uniforms(uint32_t region, Profiler::Clock::time_point frame_start) {
+    const double seconds = std::chrono::duration<double>(frame_start - start_time_).count();
+    // Wrapped while still in double precision, so the angle stays accurate however long the program runs
+    const FrameUniforms uniforms{static_cast<float>(std::fmod(seconds * options_.rotation_speed, 2 * std::numbers::pi))};
+    uniform_ring_->begin(region);
+    const auto offset = uniform_ring_->push(uniforms);
+    if (!offset)
+        throw std::runtime_error("Frame uniforms don't fit in their uniform ring region");
+    return *offset;
+}
+
+void Vulkan::create_timestamp_query_pool() {
+    timestamp_query_pool_.reset();
+    if (!profiler_)
+        return;
+    const auto valid_bits = physical_device_.getQueueFamilyProperties()[graphics_queue_family_index_].timestampValidBits;
+    if (!valid_bits) {
+        log_warning("Timestamps are not supported by the graphics queue, GPU times will not be profiled");
+        return;
+    }
+    timestamp_mask_ = valid_bits >= 64 ? ~uint64_t() : (uint64_t(1) << valid_bits) - 1;
+    timestamp_period_ = physical_device_.getProperties().limits.timestampPeriod;
+    const vk::QueryPoolCreateInfo create_info({}, vk::QueryType::eTimestamp, 2 * render_target_->image_views().size());
+    timestamp_query_pool_ = device_->createQueryPoolUnique(create_info, host_allocator_.swapchain_callbacks());
 }
 
-void Vulkan::draw_frame() {
-    bool swapchain_outdated = false;
-    try {
-        const auto image_index = device_->acquireNextImageKHR(*swapchain_, std::numeric_limits<uint64_t>::max(), *image_available_semaphore_, nullptr);
+float Vulkan::read_gpu_time(uint32_t image_index) {
+    // Only valid once the fence of the last frame that rendered to the image was waited for
+    if (!timestamp_query_pool_ || !images_in_flight_[image_index])
+        return -1;
+    std::array<uint64_t, 2> timestamps;
+    if (device_->getQueryPoolResults(*timestamp_query_pool_, 2 * image_index, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64) != vk::Result::eSuccess)
+        return -1;
+    return ((timestamps[1] - timestamps[0]) & timestamp_mask_) * timestamp_period_ / 1e6f;
+}
 
-        vk::PipelineStageFlags wait_dst_stage_mask[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-        vk::SubmitInfo submit_info(1, &*image_available_semaphore_, wait_dst_stage_mask, 1, &*command_buffers_[image_index.value], 1, &*render_finished_semaphore_);
-        graphics_queue_.submit({submit_info}, nullptr);
+bool Vulkan::draw_frame() {
+    const auto frame_start = Profiler::Clock::now();
+    FrameRecord record{frame_number_, frame_number_ ? Profiler::elapsed_ms(last_frame_start_, frame_start) : -1, 0, 0, -1, 0, 0, -1, -1, -1};
+    frame_number_++;
+    last_frame_start_ = frame_start;
+
+    // Nothing below allocates or throws in the steady state. Outdated render targets are reported through result codes.
+    auto& frame = frames_[current_frame_];
+    if (device_->waitForFences(1, &*frame.in_flight_fence, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to wait for frame fence");
+
+    const auto acquire_start = Profiler::Clock::now();
+    const auto image_index = render_target_->acquire(*frame.image_available_semaphore);
+    auto phase_start = Profiler::Clock::now();
+    record.wait_ms = Profiler::elapsed_ms(frame_start, acquire_start);
+    record.acquire_ms = Profiler::elapsed_ms(acquire_start, phase_start);
+    bool swapchain_outdated = !image_index;
+    if (image_index) {
+        // The swapchain may hand out images out of order, so the image may still be in use by another frame slot
+        auto& image_in_flight = images_in_flight_[*image_index];
+        if (image_in_flight && device_->waitForFences(1, &image_in_flight, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to wait for image fence");
+        if (profiler_) {
+            record.gpu_ms = read_gpu_time(*image_index);
+            const auto now = Profiler::Clock::now();
+            record.wait_ms += Profiler::elapsed_ms(phase_start, now);
+            phase_start = now;
+        }
+        image_in_flight = *frame.in_flight_fence;
+        // Only reset after acquiring succeeded, otherwise the next wait on this slot would deadlock
+        if (device_->resetFences(1, &*frame.in_flight_fence) != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to reset frame fence");
+
+        if (options_.record_every_frame) {
+            // The slot's previous frame completed, so everything allocated from its pools can be recycled at once
+            device_->resetCommandPool(*frame.command_pool, {});
+            for (const auto& pool : frame.secondary_command_pools)
+                device_->resetCommandPool(*pool, {});
+            device_->resetDescriptorPool(*frame.descriptor_pool);
+            const auto descriptor_set = allocate_frame_descriptor_set(*frame.descriptor_pool);
+            const auto uniform_offset = write_frame_uniforms(current_frame_, frame_start);
+            frame.submitted_command_buffer = *frame.command_buffer;
+            record_command_buffer(frame.submitted_command_buffer, frame.secondary_command_buffers, *image_index, vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                    descriptor_set, uniform_offset);
+            const auto now = Profiler::Clock::now();
+            record.record_ms = Profiler::elapsed_ms(phase_start, now);
+            phase_start = now;
+        } else {
+            // The image's previous frame completed, so neither its uniforms nor its command buffer are in use
+            write_frame_uniforms(*image_index, frame_start);
+            // Rerecorded if pipelines became ready since it was recorded
+            const auto pipeline_generation = pipeline_manager_->get_generation();
+            if (recorded_pipeline_generations_[*image_index] != pipeline_generation) {
+                recorded_pipeline_generations_[*image_index] = pipeline_generation;
+                record_command_buffer(*command_buffers_[*image_index], secondary_command_buffers_[*image_index], *image_index, vk::CommandBufferUsageFlagBits::eSimultaneousUse,
+                        descriptor_set_, uniform_ring_->get_region_offset(*image_index));
+                const auto now = Profiler::Clock::now();
+                record.record_ms = Profiler::elapsed_ms(phase_start, now);
+                phase_start = now;
+            }
+            frame.submitted_command_buffer = *command_buffers_[*image_index];
+        }
 
-        vk::PresentInfoKHR present_info(1, &*render_finished_semaphore_, 1, &*swapchain_, &image_index.value);
-        present_queue_.waitIdle();
-        const auto present_result = present_queue_.presentKHR(present_info);
-        swapchain_outdated = image_index.result == vk::Result::eSuboptimalKHR || present_result == vk::Result::eSuboptimalKHR;
-    } catch (const vk::OutOfDateKHRError& e) {
-        // image_available_semaphore_->
+        const auto render_finished_semaphore = render_finished_semaphores_.empty() ? vk::Semaphore() : *render_finished_semaphores_[*image_index];
+        frame.submit_info.pSignalSemaphores = &render_finished_semaphore;
+        if (graphics_queue_.submit(1, &frame.submit_info, *frame.in_flight_fence) != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to submit frame");
+        const auto present_start = Profiler::Clock::now();
+        record.submit_ms = Profiler::elapsed_ms(phase_start, present_start);
+
+        swapchain_outdated = !render_target_->present(*image_index, render_finished_semaphore);
+        record.present_ms = Profiler::elapsed_ms(present_start, Profiler::Clock::now());
+        record.present_latency_ms = render_target_->take_present_latency_ms();
+        current_frame_ = (current_frame_ + 1) % frames_.size();
+    }
+    if (std::exchange(render_target_recreation_requested_, false))
         swapchain_outdated = true;
+    if (swapchain_outdated) {
+        log_debug("Render target outdated at frame ", record.frame);
+        const auto recreate_start = Profiler::Clock::now();
+        const auto host_stats = host_allocator_.get_stats();
+        recreate_render_target();
+        record.recreate_ms = Profiler::elapsed_ms(recreate_start, Profiler::Clock::now());
+        const auto recreated_host_stats = host_allocator_.get_stats();
+        log_info("Render target recreated in ", record.recreate_ms, " ms, ", recreated_host_stats.allocation_count() - host_stats.allocation_count(), " driver host allocations, ",
+                recreated_host_stats.system_allocation_count - host_stats.system_allocation_count, " calls to malloc");
     }
-    watch(swapchain_outdated);
-    if (swapchain_outdated)
-        recreate_swapchain();
+    if (profiler_)
+        profiler_->push(record);
+    return !swapchain_outdated;
 }
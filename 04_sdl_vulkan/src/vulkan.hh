@@ -1,16 +1,68 @@
 #include <functional>
+#include <memory>
+#include <span>
 #include <utility>
 
 #include <vulkan/vulkan.hpp>
 
+#include "asset_pack.hh"
+#include "gpu_culling.hh"
+#include "host_allocator.hh"
+#include "memory_allocator.hh"
+#include "options.hh"
+#include "pipeline_manager.hh"
+#include "pipeline_cache.hh"
+#include "profiler.hh"
+#include "render_target.hh"
+#include "thread_pool.hh"
+#include "uniform_ring.hh"
+#include "uploader.hh"
+
 class Vulkan {
 public:
-    Vulkan(const std::vector<const char*>& required_extensions, std::function<std::pair<int, int>()>  get_extent, std::function<void()>  wait_window_show_event);
+    Vulkan(const Options& options, const std::vector<const char*>& required_extensions, std::function<std::pair<int, int>()>  get_extent, std::function<void()>  wait_window_show_event);
     [[nodiscard]] VkInstance get_instance() const { return instance_.get(); };
     void initialize(const VkSurfaceKHR surface);
-    void draw_frame();
+    // Renders into offscreen images instead of a window, options.headless_extent sets their size
+    void initialize_headless();
+    // Returns false if the render target was recreated, in which case the frame may not have been shown
+    bool draw_frame();
+    // Recreates the render target after the next frame, e.g. when the window was resized
+    void request_render_target_recreation() { render_target_recreation_requested_ = true; }
+    // Uploads total_size bytes to device local memory through the staging ring and reports the bandwidth
+    void benchmark_uploads(vk::DeviceSize total_size);
+    [[nodiscard]] uint32_t get_vertex_count() const { return vertex_count_; }
+    [[nodiscard]] uint32_t get_vertex_size() const;
+    // Blocks until the pipelines requested so far are compiled, draws are skipped until then
+    void wait_for_pipelines();
+    // Null unless profiling was enabled in the options
+    [[nodiscard]] const Profiler* get_profiler() const { return profiler_.get(); }
+    [[nodiscard]] bool is_pipeline_cache_warm() const { return pipeline_cache_ && pipeline_cache_->is_warm(); }
+    [[nodiscard]] const MemoryAllocator& get_memory_allocator() const { return *memory_allocator_; }
+    [[nodiscard]] const HostAllocator& get_host_allocator() const { return host_allocator_; }
+    ~Vulkan();
 
 private:
+    struct FrameSlot {
+        vk::UniqueSemaphore image_available_semaphore;
+        vk::UniqueFence in_flight_fence;
+        // Built once, only the command buffer and signaled semaphore it points to change every frame
+        vk::CommandBuffer submitted_command_buffer;
+        vk::SubmitInfo submit_info;
+        // Only used when recording every frame. Transient pools, reset as a whole once the slot's previous frame completed.
+        vk::UniqueCommandPool command_pool;
+        vk::UniqueCommandBuffer command_buffer;
+        // One pool and secondary command buffer per recording thread
+        std::vector<vk::UniqueCommandPool> secondary_command_pools;
+        std::vector<vk::UniqueCommandBuffer> secondary_command_buffers;
+        // Only used when recording every frame. Reset along with the command pools, so the frame's set is allocated again
+        // without freeing sets individually.
+        vk::UniqueDescriptorPool descriptor_pool;
+    };
+
+    const Options options_;
+    // Driver host memory. Destroyed last, every object is destroyed with the callbacks it was created with.
+    HostAllocator host_allocator_;
     const vk::UniqueInstance instance_;
     const std::function<std::pair<int, int>()> get_extent_;
     const std::function<void()> wait_window_show_event_;
@@ -18,35 +70,105 @@ private:
     vk::PhysicalDevice physical_device_;
     vk::UniqueDevice device_;
     int graphics_queue_family_index_, present_queue_family_index_;
-    vk::Queue graphics_queue_, present_queue_;
-    vk::Extent2D surface_extent_;
-    vk::UniqueSwapchainKHR swapchain_;
-    vk::Format swapchain_format_;
-    std::vector<vk::Image> swapchain_images_;
-    std::vector<vk::UniqueImageView> swapchain_image_views_;
+    uint32_t transfer_queue_family_index_;
+    vk::Queue graphics_queue_, present_queue_, transfer_queue_;
+    // Null unless the assets come from a pack. Declared before the pipeline manager, whose keys point to its SPIR-V.
+    std::unique_ptr<AssetPack> asset_pack_;
+    // Compiled into the executable or mapped from the asset pack
+    std::span<const uint32_t> vertex_shader_, fragment_shader_;
+    // The options' unless the mesh comes from the asset pack
+    VertexFormat vertex_format_;
+    // Must outlive every buffer and image
+    std::unique_ptr<MemoryAllocator> memory_allocator_;
+    Buffer vertex_buffer_;
+    Buffer index_buffer_;
+    uint32_t vertex_count_ = 0;
+    uint32_t index_count_ = 0;
+    Buffer instance_buffer_;
+    Buffer bounds_buffer_;
+    // Declared after the buffers it copies to, so pending copies finish before they are destroyed
+    std::unique_ptr<Uploader> uploader_;
+    std::unique_ptr<PipelineCache> pipeline_cache_;
+    // May differ from the options if the device lacks features the requested mode needs
+    DrawMode draw_mode_;
+    // Null unless VK_KHR_draw_indirect_count is supported. The instance targets Vulkan 1.1, so the core 1.2 command isn't used.
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count_ = nullptr;
+    // Null unless profiling a window and VK_KHR_present_wait is supported
+    PFN_vkWaitForPresentKHR wait_for_present_ = nullptr;
+    // Whether VK_EXT_swapchain_maintenance1 is enabled
+    bool present_fences_supported_ = false;
+    std::unique_ptr<GpuCulling> gpu_culling_;
+    std::unique_ptr<RenderTarget> render_target_;
     vk::UniqueRenderPass render_pass_;
+    vk::Format render_pass_format_;
+    // Frame uniforms at binding 0, read through a dynamic offset
+    vk::UniqueDescriptorSetLayout frame_descriptor_set_layout_;
     vk::UniquePipelineLayout pipeline_layout_;
-    vk::UniquePipeline graphics_pipeline_;
-    std::vector<vk::UniqueFramebuffer> swapchain_frame_buffers_;
+    // Declared after the render pass and layout, so compilations using them finish before they are destroyed
+    std::unique_ptr<PipelineManager> pipeline_manager_;
+    PipelineId graphics_pipeline_;
+    std::vector<vk::UniqueFramebuffer> frame_buffers_;
     vk::UniqueCommandPool command_pool_;
     std::vector<vk::UniqueCommandBuffer> command_buffers_;
-    vk::UniqueSemaphore image_available_semaphore_;
-    vk::UniqueSemaphore render_finished_semaphore_;
+    // Only used with more than one recording thread. The scene is split in one slice per thread, each recorded into a
+    // secondary command buffer from its own pool since pools can't be used by two threads at once.
+    std::unique_ptr<ThreadPool> record_thread_pool_;
+    std::vector<vk::UniqueCommandPool> secondary_command_pools_;
+    // Indexed by target image, then slice
+    std::vector<std::vector<vk::UniqueCommandBuffer>> secondary_command_buffers_;
+    // Pipeline manager generation each prerecorded command buffer was recorded at
+    std::vector<uint32_t> recorded_pipeline_generations_;
+    std::vector<FrameSlot> frames_;
+    // One region per frame slot when recording every frame, otherwise one per target image since prerecorded command
+    // buffers bind a fixed offset
+    std::unique_ptr<UniformRing> uniform_ring_;
+    // Only used by prerecorded command buffers, whose set must stay valid as long as they do
+    vk::UniqueDescriptorPool descriptor_pool_;
+    vk::DescriptorSet descriptor_set_;
+    Profiler::Clock::time_point start_time_;
+    // One per target image, empty if the target doesn't use semaphores. A fence doesn't tell when presentation consumed the
+    // semaphore it waited on, but an image is only acquired again once its previous presentation did.
+    std::vector<vk::UniqueSemaphore> render_finished_semaphores_;
+    // Fence of the frame slot currently rendering to each target image, or null
+    std::vector<vk::Fence> images_in_flight_;
+    size_t current_frame_ = 0;
+    bool render_target_recreation_requested_ = false;
+    std::unique_ptr<Profiler> profiler_;
+    // Two timestamps per target image, around its render pass. Null if profiling is disabled or timestamps are unsupported.
+    vk::UniqueQueryPool timestamp_query_pool_;
+    float timestamp_period_;
+    uint64_t timestamp_mask_;
+    uint64_t frame_number_ = 0;
+    Profiler::Clock::time_point last_frame_start_;
 
     vk::UniqueInstance create_instance(const std::vector<const char*>& required_extensions);
     void choose_physical_device();
     bool is_device_suitable(const vk::PhysicalDevice device);
     [[nodiscard]] std::pair<int, int> get_graphics_and_present_queue_families(const vk::PhysicalDevice device) const;
+    [[nodiscard]] uint32_t get_transfer_queue_family(const vk::PhysicalDevice device) const;
     void create_logical_device();
-    void recreate_swapchain();
-    vk::SurfaceCapabilitiesKHR update_surface_capabilities();
-    void create_swapchain();
-    void create_image_views();
+    void initialize_device_objects();
+    void recreate_render_target();
     void create_render_pass();
-    vk::UniqueShaderModule create_shader_module(const uint32_t *spirv, size_t code_size);
-    void create_pipeline();
+    void load_shaders();
+    void request_pipeline();
     void create_framebuffers();
+    void create_scene_buffers();
     void create_command_pool();
     void create_command_buffers();
-    void create_semaphores();
+    // secondary_command_buffers holds one buffer per slice when recording on several threads
+    // descriptor_set must point to the uniform ring, uniform_offset is the dynamic offset of the frame uniforms
+    void record_command_buffer(vk::CommandBuffer command_buffer, const std::vector<vk::UniqueCommandBuffer>& secondary_command_buffers, uint32_t image_index,
+            vk::CommandBufferUsageFlags usage, vk::DescriptorSet descriptor_set, uint32_t uniform_offset);
+    // Binds the scene state and draws instances [first_instance, first_instance + instance_count)
+    void record_draws(vk::CommandBuffer command_buffer, uint32_t image_index, vk::DescriptorSet descriptor_set, uint32_t uniform_offset, uint32_t first_instance,
+            uint32_t instance_count) const;
+    void create_frame_slots();
+    void create_uniform_ring(uint32_t region_count);
+    // Allocates a set from pool and points it to the uniform ring
+    vk::DescriptorSet allocate_frame_descriptor_set(vk::DescriptorPool pool) const;
+    // Writes the uniforms of the frame starting at frame_start into region, returns their dynamic offset
+    uint32_t write_frame_uniforms(uint32_t region, Profiler::Clock::time_point frame_start);
+    void create_timestamp_query_pool();
+    float read_gpu_time(uint32_t image_index);
 };
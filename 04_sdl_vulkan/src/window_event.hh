@@ -0,0 +1,20 @@
+#ifndef WINDOW_EVENT_HH_
+#define WINDOW_EVENT_HH_
+
+// Window events the renderer reacts to, as forwarded from the event thread to the render thread
+struct WindowEvent {
+    enum class Type {
+        resize,
+        expose,
+        quit,
+        // Keyboard or mouse input
+        input,
+    };
+
+    Type type;
+    // New drawable size of resize events
+    int width = 0;
+    int height = 0;
+};
+
+#endif